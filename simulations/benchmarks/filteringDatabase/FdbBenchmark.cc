@@ -0,0 +1,259 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+// Microbenchmark of the filtering database table with 100k entries. It
+// compares the FlatHashMap of FilteringDatabase with the former
+// std::unordered_map keyed on MacAddress, hashed through its string form and
+// holding a port vector. Only the table is measured, so neither OMNeT++ nor
+// INET is needed. From this directory build and run it with:
+//
+//   g++ -O2 -std=c++11 -DNESTING_FDB_BENCHMARK -I../../../src FdbBenchmark.cc
+//   ./a.out
+//
+// Without NESTING_FDB_BENCHMARK the file is empty, so that the simulation
+// build does not pick up its main function.
+
+#ifdef NESTING_FDB_BENCHMARK
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "nesting/common/containers/FlatHashMap.h"
+
+namespace {
+
+const size_t kNumberOfEntries = 100000;
+const size_t kNumberOfOperations = 1000000;
+const int kNumberOfPorts = 8;
+
+size_t numAllocations = 0;
+
+/** Entry of FilteringDatabase, with the timestamp as double. */
+struct Entry {
+    double timestamp = 0;
+    bool learned = false;
+    uint64_t agingTick = 0;
+    int port = -1;
+    int portSet = -1;
+};
+
+/** MAC address of the former table, hashed through its string form. */
+struct Mac {
+    uint64_t address;
+    bool operator==(const Mac& other) const {
+        return address == other.address;
+    }
+    std::string str() const {
+        char buf[18];
+        snprintf(buf, sizeof(buf), "%02X-%02X-%02X-%02X-%02X-%02X",
+                static_cast<unsigned int>(address >> 40 & 0xFF),
+                static_cast<unsigned int>(address >> 32 & 0xFF),
+                static_cast<unsigned int>(address >> 24 & 0xFF),
+                static_cast<unsigned int>(address >> 16 & 0xFF),
+                static_cast<unsigned int>(address >> 8 & 0xFF),
+                static_cast<unsigned int>(address & 0xFF));
+        return buf;
+    }
+};
+
+struct MacHash {
+    size_t operator()(const Mac& mac) const noexcept {
+        return std::hash<std::string> { }(mac.str());
+    }
+};
+
+typedef std::unordered_map<Mac, std::pair<double, std::vector<int>>, MacHash> MapTable;
+typedef nesting::FlatHashMap<Entry> FlatTable;
+
+/** Lookup with refresh as in the former FilteringDatabase::getPort(). */
+int mapGetPort(MapTable& table, Mac mac, double now) {
+    auto it = table.find(mac);
+    if (it == table.end()) {
+        return -1;
+    }
+    std::vector<int> port = it->second.second;
+    if (port.size() != 1) {
+        return -1;
+    }
+    table[mac] = std::pair<double, std::vector<int>>(now, port);
+    return port.at(0);
+}
+
+/** Learning as in the former FilteringDatabase::insert(). */
+void mapInsert(MapTable& table, Mac mac, double now, int port) {
+    std::vector<int> tmp;
+    tmp.insert(tmp.begin(), 1, port);
+    table[mac] = std::pair<double, std::vector<int>>(now, tmp);
+}
+
+/** Lookup with refresh as in FilteringDatabase::getPort(). */
+int flatGetPort(FlatTable& table, uint64_t key, double now) {
+    Entry* entry = table.find(key);
+    if (entry == nullptr || entry->port < 0) {
+        return -1;
+    }
+    if (entry->learned) {
+        entry->timestamp = now;
+    }
+    return entry->port;
+}
+
+/** Learning as in FilteringDatabase::insert(). */
+void flatInsert(FlatTable& table, uint64_t key, double now, int port) {
+    Entry* entry = table.find(key);
+    if (entry == nullptr) {
+        entry = &table[key];
+        entry->learned = true;
+    }
+    entry->timestamp = now;
+    entry->port = port;
+    entry->portSet = -1;
+}
+
+struct Result {
+    double nanosPerOperation;
+    double allocationsPerOperation;
+    long checksum;
+};
+
+template<typename F>
+Result measure(size_t operations, F function) {
+    size_t allocationsBefore = numAllocations;
+    auto start = std::chrono::steady_clock::now();
+    long checksum = 0;
+    for (size_t i = 0; i < operations; i++) {
+        checksum += function(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    Result result;
+    result.nanosPerOperation = std::chrono::duration<double, std::nano>(
+            end - start).count() / operations;
+    result.allocationsPerOperation =
+            static_cast<double>(numAllocations - allocationsBefore)
+                    / operations;
+    result.checksum = checksum;
+    return result;
+}
+
+void print(const char* operation, const Result& map, const Result& flat) {
+    printf("%-16s %10.1f %10.2f %10.1f %10.2f\n", operation,
+            map.nanosPerOperation, map.allocationsPerOperation,
+            flat.nanosPerOperation, flat.allocationsPerOperation);
+    if (map.checksum != flat.checksum) {
+        fprintf(stderr, "%s: results differ\n", operation);
+        exit(1);
+    }
+}
+
+} // namespace
+
+void* operator new(size_t size) {
+    numAllocations++;
+    void* p = malloc(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+int main() {
+    std::mt19937_64 random(42);
+    std::vector<uint64_t> addresses(kNumberOfEntries);
+    for (uint64_t& address : addresses) {
+        // Individual, locally administered addresses
+        address = (random() & 0xFCFFFFFFFFFFULL) | 0x020000000000ULL;
+    }
+    std::vector<uint64_t> known(kNumberOfOperations);
+    std::vector<uint64_t> unknown(kNumberOfOperations);
+    for (size_t i = 0; i < kNumberOfOperations; i++) {
+        known[i] = addresses[random() % kNumberOfEntries];
+        // Group addresses, which are never learned
+        unknown[i] = (random() & 0xFCFFFFFFFFFFULL) | 0x010000000000ULL;
+    }
+
+    MapTable mapTable;
+    FlatTable flatTable;
+    printf("%zu entries, %zu operations per measurement\n", kNumberOfEntries,
+            kNumberOfOperations);
+    printf("%-16s %10s %10s %10s %10s\n", "", "map ns/op", "map alloc",
+            "flat ns/op", "flat alloc");
+
+    Result map = measure(kNumberOfEntries, [&](size_t i) {
+        mapInsert(mapTable, Mac { addresses[i] }, 0, i % kNumberOfPorts);
+        return 0;
+    });
+    Result flat = measure(kNumberOfEntries, [&](size_t i) {
+        flatInsert(flatTable, addresses[i], 0, i % kNumberOfPorts);
+        return 0;
+    });
+    print("learn new", map, flat);
+
+    map = measure(kNumberOfOperations, [&](size_t i) {
+        return mapGetPort(mapTable, Mac { known[i] }, i);
+    });
+    flat = measure(kNumberOfOperations, [&](size_t i) {
+        return flatGetPort(flatTable, known[i], i);
+    });
+    print("lookup hit", map, flat);
+
+    map = measure(kNumberOfOperations, [&](size_t i) {
+        return mapGetPort(mapTable, Mac { unknown[i] }, i);
+    });
+    flat = measure(kNumberOfOperations, [&](size_t i) {
+        return flatGetPort(flatTable, unknown[i], i);
+    });
+    print("lookup miss", map, flat);
+
+    map = measure(kNumberOfOperations, [&](size_t i) {
+        mapInsert(mapTable, Mac { known[i] }, i, i % kNumberOfPorts);
+        return 0;
+    });
+    flat = measure(kNumberOfOperations, [&](size_t i) {
+        flatInsert(flatTable, known[i], i, i % kNumberOfPorts);
+        return 0;
+    });
+    print("learn known", map, flat);
+
+    MapTable otherMapTable;
+    FlatTable otherFlatTable;
+    map = measure(kNumberOfOperations, [&](size_t) {
+        mapTable.swap(otherMapTable);
+        return 0;
+    });
+    flat = measure(kNumberOfOperations, [&](size_t) {
+        flatTable.swap(otherFlatTable);
+        return 0;
+    });
+    print("swap", map, flat);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,221 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef NESTING_COMMON_CONTAINERS_FLATHASHMAP_H_
+#define NESTING_COMMON_CONTAINERS_FLATHASHMAP_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+namespace nesting {
+
+/**
+ * Hash map from 64 bit keys to values, stored in a single array with open
+ * addressing and linear probing. Lookups touch one or few adjacent slots and
+ * do not allocate. The array is doubled when it is filled to more than 70%.
+ *
+ * Erasing uses backward shifting, so the table never contains tombstones.
+ */
+template<typename V>
+class FlatHashMap {
+protected:
+    struct Slot {
+        uint64_t key;
+        V value;
+        bool used;
+    };
+
+    /** Slots of the table. The size is always a power of two. */
+    std::vector<Slot> slots;
+
+    /** Number of used slots. */
+    size_t numberOfEntries = 0;
+
+protected:
+    /** Mixes all key bits into the bits used for the slot index. */
+    static uint64_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    size_t indexOf(uint64_t key) const {
+        return hash(key) & (slots.size() - 1);
+    }
+
+    size_t next(size_t index) const {
+        return (index + 1) & (slots.size() - 1);
+    }
+
+    /**
+     * Returns the slot holding the key, or the empty slot where the key
+     * would be inserted.
+     */
+    size_t probe(uint64_t key) const {
+        size_t index = indexOf(key);
+        while (slots[index].used && slots[index].key != key) {
+            index = next(index);
+        }
+        return index;
+    }
+
+    void grow() {
+        std::vector<Slot> oldSlots(slots.size() * 2);
+        oldSlots.swap(slots);
+        for (Slot& slot : oldSlots) {
+            if (slot.used) {
+                Slot& target = slots[probe(slot.key)];
+                target.key = slot.key;
+                target.value = std::move(slot.value);
+                target.used = true;
+            }
+        }
+    }
+
+public:
+    explicit FlatHashMap(size_t initialCapacity = 16) {
+        size_t capacity = 2;
+        while (capacity < initialCapacity) {
+            capacity *= 2;
+        }
+        slots.resize(capacity);
+    }
+
+    /** Returns the value of a key, or nullptr if the key is not present. */
+    V* find(uint64_t key) {
+        Slot& slot = slots[probe(key)];
+        return slot.used ? &slot.value : nullptr;
+    }
+    const V* find(uint64_t key) const {
+        const Slot& slot = slots[probe(key)];
+        return slot.used ? &slot.value : nullptr;
+    }
+
+    /**
+     * Returns the value of a key. A default constructed value is inserted if
+     * the key is not present.
+     */
+    V& operator[](uint64_t key) {
+        size_t index = probe(key);
+        if (!slots[index].used) {
+            if ((numberOfEntries + 1) * 10 > slots.size() * 7) {
+                grow();
+                index = probe(key);
+            }
+            slots[index].key = key;
+            slots[index].value = V();
+            slots[index].used = true;
+            numberOfEntries++;
+        }
+        return slots[index].value;
+    }
+
+    /**
+     * Inserts or replaces the value of a key.
+     *
+     * @return True if the key was not present before.
+     */
+    bool insert(uint64_t key, const V& value) {
+        size_t entriesBefore = numberOfEntries;
+        (*this)[key] = value;
+        return numberOfEntries > entriesBefore;
+    }
+
+    /**
+     * Removes a key.
+     *
+     * @return True if the key was present.
+     */
+    bool erase(uint64_t key) {
+        size_t index = probe(key);
+        if (!slots[index].used) {
+            return false;
+        }
+        // Shift following entries of the probe sequence back into the gap
+        size_t gap = index;
+        for (size_t i = next(index); slots[i].used; i = next(i)) {
+            size_t home = indexOf(slots[i].key);
+            // Move the entry if its home slot is not in (gap, i]
+            bool movable = gap <= i ? (home <= gap || home > i) :
+                                      (home <= gap && home > i);
+            if (movable) {
+                slots[gap].key = slots[i].key;
+                slots[gap].value = std::move(slots[i].value);
+                gap = i;
+            }
+        }
+        slots[gap].used = false;
+        slots[gap].value = V();
+        numberOfEntries--;
+        return true;
+    }
+
+    void clear() {
+        for (Slot& slot : slots) {
+            slot.used = false;
+            slot.value = V();
+        }
+        numberOfEntries = 0;
+    }
+
+    void swap(FlatHashMap& other) {
+        slots.swap(other.slots);
+        std::swap(numberOfEntries, other.numberOfEntries);
+    }
+
+    size_t size() const {
+        return numberOfEntries;
+    }
+
+    bool empty() const {
+        return numberOfEntries == 0;
+    }
+
+    /** Calls function(key, value) for every entry, in no particular order. */
+    template<typename F>
+    void forEach(F function) const {
+        for (const Slot& slot : slots) {
+            if (slot.used) {
+                function(slot.key, slot.value);
+            }
+        }
+    }
+
+    /**
+     * Calls function(key, value) for every entry and erases the entries for
+     * which it returns true.
+     */
+    template<typename F>
+    void eraseIf(F function) {
+        std::vector<uint64_t> keys;
+        for (Slot& slot : slots) {
+            if (slot.used && function(slot.key, slot.value)) {
+                keys.push_back(slot.key);
+            }
+        }
+        for (uint64_t key : keys) {
+            erase(key);
+        }
+    }
+};
+
+} // namespace nesting
+
+#endif /* NESTING_COMMON_CONTAINERS_FLATHASHMAP_H_ */
@@ -0,0 +1,88 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef NESTING_COMMON_CONTAINERS_PORTSET_H_
+#define NESTING_COMMON_CONTAINERS_PORTSET_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace nesting {
+
+/**
+ * Set of port numbers stored as bit mask of arbitrary width. Iterating the
+ * set visits the set bits only, 64 ports per word.
+ */
+class PortSet {
+protected:
+    /** Bit i of word w is set if port 64 * w + i is in the set. */
+    std::vector<uint64_t> words;
+
+public:
+    /** Adds a non-negative port number. */
+    void add(int port) {
+        size_t word = static_cast<size_t>(port) / 64;
+        if (word >= words.size()) {
+            words.resize(word + 1);
+        }
+        words[word] |= static_cast<uint64_t>(1) << (port % 64);
+    }
+
+    bool contains(int port) const {
+        size_t word = static_cast<size_t>(port) / 64;
+        return port >= 0 && word < words.size()
+                && (words[word] >> (port % 64)) & 1;
+    }
+
+    bool empty() const {
+        for (uint64_t word : words) {
+            if (word != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** Calls function(port) for every port in increasing order. */
+    template<typename F>
+    void forEach(F function) const {
+        for (size_t i = 0; i < words.size(); i++) {
+            uint64_t word = words[i];
+            while (word != 0) {
+                function(static_cast<int>(i * 64 + __builtin_ctzll(word)));
+                // Clear the lowest set bit
+                word &= word - 1;
+            }
+        }
+    }
+
+    /** Returns the ports separated by spaces. */
+    std::string str() const {
+        std::string result;
+        forEach([&result](int port) {
+            if (!result.empty()) {
+                result += ' ';
+            }
+            result += std::to_string(port);
+        });
+        return result;
+    }
+};
+
+} // namespace nesting
+
+#endif /* NESTING_COMMON_CONTAINERS_PORTSET_H_ */
@@ -0,0 +1,126 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef NESTING_COMMON_CONTAINERS_TIMERWHEEL_H_
+#define NESTING_COMMON_CONTAINERS_TIMERWHEEL_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace nesting {
+
+/**
+ * Hierarchical timer wheel for 64 bit keys expiring at integer ticks. Level
+ * 0 has one bucket per tick, every further level one bucket per revolution
+ * of the level below. Timers of a higher level bucket are moved to the lower
+ * levels when the wheel reaches the bucket, so scheduling and expiring a
+ * timer takes constant time independent of the number of timers.
+ *
+ * Timers cannot be cancelled. The owner has to check whether the key of an
+ * expired timer is still meant to expire at that tick.
+ */
+class TimerWheel {
+protected:
+    static const unsigned int kLevelBits = 8;
+    static const uint64_t kBucketMask = (1u << kLevelBits) - 1;
+    static const unsigned int kNumberOfLevels = 3;
+
+    struct Timer {
+        uint64_t key;
+        uint64_t expiryTick;
+    };
+
+    /**
+     * Timers by level and bucket. The buckets keep their capacity, so filing
+     * timers does not allocate once the wheel is warmed up.
+     */
+    std::vector<Timer> buckets[kNumberOfLevels][kBucketMask + 1];
+
+    uint64_t currentTick = 0;
+
+    /** Number of scheduled timers. */
+    size_t numberOfTimers = 0;
+
+protected:
+    void file(const Timer& timer) {
+        uint64_t delta = timer.expiryTick - currentTick;
+        for (unsigned int level = 0; level < kNumberOfLevels; level++) {
+            if (delta >> ((level + 1) * kLevelBits) == 0) {
+                buckets[level][(timer.expiryTick >> (level * kLevelBits))
+                        & kBucketMask].push_back(timer);
+                return;
+            }
+        }
+        // Beyond the range of the wheel, filed again when the last bucket in
+        // range is reached
+        unsigned int top = kNumberOfLevels - 1;
+        uint64_t lastTickInRange = currentTick
+                + (static_cast<uint64_t>(1) << (kNumberOfLevels * kLevelBits))
+                - 1;
+        buckets[top][(lastTickInRange >> (top * kLevelBits)) & kBucketMask].push_back(
+                timer);
+    }
+
+public:
+    /**
+     * Schedules a key to expire at the given tick, which has to be later than
+     * the current tick.
+     */
+    void schedule(uint64_t key, uint64_t expiryTick) {
+        file(Timer { key, expiryTick });
+        numberOfTimers++;
+    }
+
+    /**
+     * Advances the wheel by one tick and calls function(key) for every timer
+     * expiring at the new current tick. The function may schedule new timers.
+     */
+    template<typename F>
+    void advance(F function) {
+        currentTick++;
+        // Move timers of higher level buckets reached now towards level 0
+        for (unsigned int level = kNumberOfLevels - 1; level > 0; level--) {
+            uint64_t levelTicks = static_cast<uint64_t>(1)
+                    << (level * kLevelBits);
+            if ((currentTick & (levelTicks - 1)) == 0) {
+                std::vector<Timer>& bucket = buckets[level][(currentTick
+                        >> (level * kLevelBits)) & kBucketMask];
+                for (size_t i = 0; i < bucket.size(); i++) {
+                    file(bucket[i]);
+                }
+                bucket.clear();
+            }
+        }
+        std::vector<Timer>& bucket = buckets[0][currentTick & kBucketMask];
+        numberOfTimers -= bucket.size();
+        for (size_t i = 0; i < bucket.size(); i++) {
+            function(bucket[i].key);
+        }
+        bucket.clear();
+    }
+
+    uint64_t getCurrentTick() const {
+        return currentTick;
+    }
+
+    size_t size() const {
+        return numberOfTimers;
+    }
+};
+
+} // namespace nesting
+
+#endif /* NESTING_COMMON_CONTAINERS_TIMERWHEEL_H_ */
@@ -49,9 +49,16 @@ const int kMinSupportedQueues = 1;
 const int selfMessageSchedulingPriority = 1;
 
 const inet::B kFramePreemptionMinFinalPayloadSize = inet::B(60);
-// TODO make MinNonFinalPayloadSize a parameter
 const inet::B kFramePreemptionMinNonFinalPayloadSize = inet::B(60); //or 124,188,252
 
+/**
+ * Minimum payload size of a non-final mPacket for an addFragSize value of
+ * 0 to 3 according to IEEE 802.3br, i.e. 60, 124, 188 or 252 bytes.
+ */
+inline inet::B framePreemptionMinNonFinalPayloadSize(int addFragSize) {
+    return kFramePreemptionMinNonFinalPayloadSize + inet::B(64 * addFragSize);
+}
+
 const inet::B ETHER_MAC_FRAME_BYTES = inet::B(18);
 const inet::B PREAMBLE_BYTES = inet::B(7);
 const inet::B SFD_BYTES = inet::B(1);
@@ -40,6 +40,10 @@ ClockBase::~ClockBase() {
         deleteScheduledTickEntry(entry);
     }
     scheduledTicks.clear();
+    for (auto entry : freeScheduledTickEntries) {
+        deleteScheduledTickEntry(entry);
+    }
+    freeScheduledTickEntries.clear();
 }
 
 void ClockBase::handleMessage(cMessage* message) {
@@ -52,7 +56,7 @@ void ClockBase::handleMessage(cMessage* message) {
 
         updateTimeOnScheduledTick();
         notifyNextTick();
-        deleteScheduledTickEntry(scheduledTicks.front());
+        releaseScheduledTickEntry(scheduledTicks.front());
         scheduledTicks.pop_front();
 
         tick = false;
@@ -83,10 +87,9 @@ void ClockBase::addScheduledTickListener(unsigned int idleTicks,
     }
     else {
         // Insert scheduled tick into datastructure.
-        scheduledTickEntry = new ScheduledTickEntry();
+        scheduledTickEntry = allocateScheduledTickEntry();
         scheduledTickEntry->scheduledTick.ticks = idleTicks;
         scheduledTickEntry->scheduledTick.timestamp = scheduleTick(idleTicks);
-        scheduledTickEntry->tickMessage = new cMessage();
 
         it = scheduledTicks.insert(it, scheduledTickEntry);
 
@@ -172,6 +175,23 @@ void ClockBase::decrementScheduledTickCountdowns(unsigned int ticks) {
     }
 }
 
+ClockBase::ScheduledTickEntry* ClockBase::allocateScheduledTickEntry() {
+    if (freeScheduledTickEntries.empty()) {
+        ScheduledTickEntry* entry = new ScheduledTickEntry();
+        entry->tickMessage = new cMessage("tick");
+        return entry;
+    }
+    ScheduledTickEntry* entry = freeScheduledTickEntries.back();
+    freeScheduledTickEntries.pop_back();
+    return entry;
+}
+
+void ClockBase::releaseScheduledTickEntry(ScheduledTickEntry* entry) {
+    cancelEvent(entry->tickMessage);
+    entry->listeners.clear();
+    freeScheduledTickEntries.push_back(entry);
+}
+
 void ClockBase::deleteScheduledTickEntry(ScheduledTickEntry* entry) {
     cancelAndDelete(entry->tickMessage);
     delete entry;
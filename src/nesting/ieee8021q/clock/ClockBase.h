@@ -19,6 +19,7 @@
 #include <omnetpp.h>
 #include <tuple>
 #include <list>
+#include <vector>
 #include <algorithm>
 #include <functional>
 
@@ -65,12 +66,13 @@ public:
 
         /**
          * Message that is used as self message to signal that the tick was
-         * triggered.
+         * triggered. It is kept together with the entry when the entry is
+         * recycled.
          */
         cMessage *tickMessage;
 
         /** Listeners that have subscribed themselves for the tick event. */
-        std::list<IClockListener*> listeners;
+        std::vector<IClockListener*> listeners;
     };
 protected:
     /** Global time-stamp when the last tick event happened. */
@@ -113,6 +115,14 @@ protected:
      */
     std::list<ScheduledTickEntry*> scheduledTicks;
 
+    /**
+     * Scheduled tick entries that are currently unused. Entries of elapsed
+     * ticks are put here and reused for new scheduled ticks, so that no tick
+     * entries and messages have to be allocated once the simulation reached
+     * a steady state.
+     */
+    std::vector<ScheduledTickEntry*> freeScheduledTickEntries;
+
 protected:
     /** @copydoc cSimpleModule::initialize() */
     virtual void initialize() override;
@@ -173,6 +183,15 @@ protected:
     /** Notifies the next scheduled tick's listeners. */
     virtual void notifyNextTick();
 
+    /**
+     * Returns an unused scheduled tick entry without listeners, either from
+     * the pool of free entries or newly allocated.
+     */
+    virtual ScheduledTickEntry* allocateScheduledTickEntry();
+
+    /** Returns a scheduled tick entry to the pool of free entries. */
+    virtual void releaseScheduledTickEntry(ScheduledTickEntry* entry);
+
     /** Deletes a scheduled tick entry and it's subcomponents from memory. */
     virtual void deleteScheduledTickEntry(ScheduledTickEntry* entry);
 
@@ -14,6 +14,7 @@
 // 
 
 #include "../queue/QueuingFrames.h"
+#include "gating/CyclicQueuingController.h"
 #define COMPILETIME_LOGLEVEL omnetpp::LOGLEVEL_TRACE
 
 namespace nesting {
@@ -33,6 +34,16 @@ void QueuingFrames::initialize() {
                 "Invalid assignment of numberOfQueues. Number of queues should not "
                         "be bigger than the number of all possible pcp values!");
     }
+
+    streamClassifier.load(par("streamClassification").xmlValue(),
+            numberOfQueues);
+
+    if (strlen(par("cqfControllerModule").stringValue()) > 0) {
+        cqfController = getModuleFromPar<CyclicQueuingController>(
+                par("cqfControllerModule"), this);
+    }
+
+    WATCH(numPacketsClassifiedByStream);
 }
 
 void QueuingFrames::handleMessage(cMessage *msg) {
@@ -57,8 +68,6 @@ void QueuingFrames::handleMessage(cMessage *msg) {
     auto sapTagOut = packet->addTag<inet::Ieee802SapReq>();
     sapTagOut->setDsap(sapTagIn->getDsap());
     sapTagOut->setSsap(sapTagIn->getSsap());
-    delete macTagIn;
-    delete vlanTagIn;
     delete sapTagIn;
 
     // remove encapsulation
@@ -71,10 +80,24 @@ void QueuingFrames::handleMessage(cMessage *msg) {
                         "bigger than the number of supported queues.");
     }
 
-    // Get the corresponding queue from the 2-dimensional matrix
-    // standardTrafficClassMapping.
-    int queueIndex =
-            this->standardTrafficClassMapping[numberOfQueues - 1][pcpValue];
+    // Streams with a configured queue take precedence, all other frames get
+    // the queue from the 2-dimensional matrix standardTrafficClassMapping.
+    int queueIndex = -1;
+    if (!streamClassifier.isEmpty()) {
+        queueIndex = streamClassifier.classify(macTagIn->getDestAddress(),
+                macTagIn->getSrcAddress(), vlanTagIn->getVID(), pcpValue);
+    }
+    delete macTagIn;
+    delete vlanTagIn;
+    if (queueIndex >= 0) {
+        numPacketsClassifiedByStream++;
+    } else {
+        queueIndex =
+                this->standardTrafficClassMapping[numberOfQueues - 1][pcpValue];
+    }
+    if (cqfController != nullptr) {
+        queueIndex = cqfController->receivingQueue(queueIndex);
+    }
 
     // Get the corresponding gate and transmit the frame to it.
     EV_TRACE << getFullPath() << ": Sending packet '" << packet
@@ -85,4 +108,8 @@ void QueuingFrames::handleMessage(cMessage *msg) {
     send(msg, outputGate);
 }
 
+void QueuingFrames::finish() {
+    recordScalar("packetsClassifiedByStream", numPacketsClassifiedByStream);
+}
+
 } // namespace nesting
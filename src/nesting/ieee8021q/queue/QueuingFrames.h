@@ -24,11 +24,14 @@
 #include "inet/linklayer/common/Ieee802SapTag_m.h"
 #include "../Ieee8021q.h"
 #include "../../linklayer/common/VLANTag_m.h"
+#include "StreamClassifier.h"
 
 using namespace omnetpp;
 
 namespace nesting {
 
+class CyclicQueuingController;
+
 /** See NED file for a detailed description */
 class QueuingFrames: public cSimpleModule {
 private:
@@ -51,11 +54,25 @@ private:
           };
 
 
+    /** Stream rules overriding the PCP based traffic class mapping. */
+    StreamClassifier streamClassifier;
+
+    /**
+     * CQF controller selecting the receiving queue of queue pairs, nullptr
+     * if CQF is not used.
+     */
+    CyclicQueuingController* cqfController = nullptr;
+
+    /** Number of packets mapped to a queue by a stream rule. */
+    long numPacketsClassifiedByStream = 0;
+
     int getFramePriority(int numberOfQueues);
 protected:
     virtual void initialize();
 
     virtual void handleMessage(cMessage *msg);
+
+    virtual void finish() override;
 };
 
 } // namespace nesting
@@ -0,0 +1,164 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef NESTING_IEEE8021Q_QUEUE_SELECTIONCORE_H_
+#define NESTING_IEEE8021Q_QUEUE_SELECTIONCORE_H_
+
+#include <array>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#include "gating/TransmissionGate.h"
+#include "framePreemption/LengthAwareQueue.h"
+#include "transmissionSelectionAlgorithms/StrictPriority.h"
+#include "transmissionSelectionAlgorithms/CreditBasedShaper.h"
+
+namespace nesting {
+
+/**
+ * Finds the highest priority queue that can transmit a frame right now. Used
+ * by ~TransmissionSelection for the candidates of its bitmasks.
+ */
+class ISelectionCore {
+public:
+    virtual ~ISelectionCore() {
+    }
+    ;
+
+    /**
+     * Returns the index of the highest queue in candidates, whose gate is not
+     * blocked and whose head frame fits through the gate, or -1 if there is
+     * none.
+     *
+     * @param candidates  Bitmask of the queues to consider.
+     * @param expressMask Bitmask of the express queues.
+     */
+    virtual int highestReadyQueue(unsigned int candidates,
+            unsigned int expressMask) = 0;
+};
+
+/**
+ * Selection core for a fixed number of N queues, each with a StrictPriority
+ * algorithm or, if Shaper is CreditBasedShaper, a StrictPriority or
+ * CreditBasedShaper algorithm.
+ *
+ * The checks of TransmissionGate::isEmpty() are done directly on the gate,
+ * shaper and queue of a candidate with non-virtual calls, so that selecting a
+ * queue costs one virtual call instead of several per candidate.
+ */
+template<unsigned int N, typename Shaper>
+class SelectionCore: public ISelectionCore {
+    static_assert(N >= 1 && N <= kMaxSupportedQueues,
+            "unsupported number of queues");
+    static_assert(std::is_same<Shaper, StrictPriority>::value
+            || std::is_same<Shaper, CreditBasedShaper>::value,
+            "unsupported transmission selection algorithm");
+protected:
+    static constexpr unsigned int kQueueMask = (1u << N) - 1;
+
+    std::array<TransmissionGate*, N> gates;
+
+    std::array<TSAlgorithm*, N> tsAlgorithms;
+
+    /** Bitmask of the queues with a credit-based shaper. */
+    unsigned int shapedMask = 0;
+
+protected:
+    /** Returns true if the queue with the given index can transmit. */
+    bool isReady(unsigned int index, bool express) {
+        TransmissionGate* gate = gates[index];
+        if (gate->isBlocked(express)) {
+            return false;
+        }
+        if (std::is_same<Shaper, CreditBasedShaper>::value
+                && (shapedMask & (1u << index))) {
+            auto shaper = static_cast<CreditBasedShaper*>(tsAlgorithms[index]);
+            if (!shaper->CreditBasedShaper::isCreditPositive()) {
+                return false;
+            }
+        }
+        LengthAwareQueue* queue = tsAlgorithms[index]->getQueue();
+        return !queue->LengthAwareQueue::isEmpty(
+                gate->TransmissionGate::maxTransferableBits());
+    }
+
+public:
+    explicit SelectionCore(const std::vector<TransmissionGate*>& tGates) {
+        ASSERT(supports(tGates));
+        for (unsigned int i = 0; i < N; i++) {
+            gates[i] = tGates[i];
+            tsAlgorithms[i] = tGates[i]->getTSAlgorithm();
+            if (typeid(*tsAlgorithms[i]) == typeid(CreditBasedShaper)) {
+                shapedMask |= 1u << i;
+            }
+        }
+    }
+
+    /**
+     * Returns true if the transmission gates match the number of queues and
+     * algorithms of this core.
+     */
+    static bool supports(const std::vector<TransmissionGate*>& tGates) {
+        if (tGates.size() != N) {
+            return false;
+        }
+        for (TransmissionGate* gate : tGates) {
+            const std::type_info& type = typeid(*gate->getTSAlgorithm());
+            if (type != typeid(StrictPriority) && type != typeid(Shaper)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    virtual int highestReadyQueue(unsigned int candidates,
+            unsigned int expressMask) override {
+        candidates &= kQueueMask;
+        while (candidates != 0) {
+            // Highest set bit is the highest priority candidate
+            unsigned int index = sizeof(unsigned int) * 8 - 1
+                    - __builtin_clz(candidates);
+            if (isReady(index, expressMask & (1u << index))) {
+                return index;
+            }
+            candidates &= ~(1u << index);
+        }
+        return -1;
+    }
+};
+
+/**
+ * Returns a selection core specialized for the given transmission gates, or
+ * nullptr if there is no specialization for their number of queues and
+ * transmission selection algorithms.
+ */
+inline ISelectionCore* createSelectionCore(
+        const std::vector<TransmissionGate*>& tGates) {
+    if (SelectionCore<8, StrictPriority>::supports(tGates)) {
+        return new SelectionCore<8, StrictPriority>(tGates);
+    } else if (SelectionCore<8, CreditBasedShaper>::supports(tGates)) {
+        return new SelectionCore<8, CreditBasedShaper>(tGates);
+    } else if (SelectionCore<2, StrictPriority>::supports(tGates)) {
+        return new SelectionCore<2, StrictPriority>(tGates);
+    } else if (SelectionCore<2, CreditBasedShaper>::supports(tGates)) {
+        return new SelectionCore<2, CreditBasedShaper>(tGates);
+    }
+    return nullptr;
+}
+
+} // namespace nesting
+
+#endif /* NESTING_IEEE8021Q_QUEUE_SELECTIONCORE_H_ */
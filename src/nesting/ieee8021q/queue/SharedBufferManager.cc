@@ -0,0 +1,126 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "SharedBufferManager.h"
+
+namespace nesting {
+
+Define_Module(SharedBufferManager);
+
+void SharedBufferManager::initialize(int stage) {
+    if (stage == INITSTAGE_LOCAL) {
+        occupancySignal = registerSignal("occupancy");
+
+        totalCapacity = par("totalCapacity");
+        alpha = par("alpha");
+        if (totalCapacity < 0) {
+            throw cRuntimeError("Parameter totalCapacity must not be negative.");
+        }
+        if (alpha <= 0) {
+            throw cRuntimeError("Parameter alpha must be positive.");
+        }
+
+        WATCH(totalReservedBits);
+        WATCH(totalOccupiedBits);
+        WATCH(sharedOccupiedBits);
+        WATCH(maxTotalOccupiedBits);
+
+        emit(occupancySignal, totalOccupiedBits);
+    }
+}
+
+int SharedBufferManager::numInitStages() const {
+    return INITSTAGE_LINK_LAYER + 1;
+}
+
+void SharedBufferManager::handleMessage(cMessage* msg) {
+    throw cRuntimeError("cannot handle messages");
+}
+
+void SharedBufferManager::finish() {
+    recordScalar("totalReserved", totalReservedBits);
+    recordScalar("maxTotalOccupancy", maxTotalOccupiedBits);
+    for (const QueueState& state : queues) {
+        std::string path = state.queue->getFullPath();
+        recordScalar(("maxOccupancy " + path).c_str(), state.maxOccupiedBits);
+        recordScalar(("rejected " + path).c_str(), state.numRejected);
+    }
+}
+
+int64_t SharedBufferManager::freeSharedBits() const {
+    return totalCapacity - totalReservedBits - sharedOccupiedBits;
+}
+
+int SharedBufferManager::registerQueue(cModule* queue, int64_t reservedBits) {
+    Enter_Method("registerQueue()");
+    if (reservedBits < 0) {
+        throw cRuntimeError("Buffer reservation of %s must not be negative.",
+                queue->getFullPath().c_str());
+    }
+    if (totalReservedBits + reservedBits > totalCapacity) {
+        throw cRuntimeError(
+                "Buffer reservation of %s exceeds the capacity of the shared buffer (%ld of %ld bits already reserved).",
+                queue->getFullPath().c_str(), (long) totalReservedBits,
+                (long) totalCapacity);
+    }
+    totalReservedBits += reservedBits;
+    queues.push_back( { queue, reservedBits, 0, 0, 0 });
+    return queues.size() - 1;
+}
+
+bool SharedBufferManager::allocate(int queueId, int64_t bits) {
+    Enter_Method("allocate()");
+    QueueState& state = queues.at(queueId);
+
+    int64_t queueSharedBits = sharedBits(state.occupiedBits,
+            state.reservedBits);
+    int64_t requiredSharedBits = sharedBits(state.occupiedBits + bits,
+            state.reservedBits) - queueSharedBits;
+    if (requiredSharedBits > 0) {
+        // Dynamic threshold: a queue may only grow into the shared pool while
+        // its share is below alpha times the unused part of the pool.
+        int64_t freeBits = freeSharedBits();
+        if (requiredSharedBits > freeBits || queueSharedBits >= alpha * freeBits) {
+            state.numRejected++;
+            EV_DETAIL << getFullPath() << ": Rejected " << bits << "bits for "
+                             << state.queue->getFullPath() << " (shared "
+                             << queueSharedBits << "bits, free " << freeBits
+                             << "bits)." << endl;
+            return false;
+        }
+        sharedOccupiedBits += requiredSharedBits;
+    }
+
+    state.occupiedBits += bits;
+    totalOccupiedBits += bits;
+    state.maxOccupiedBits = std::max(state.maxOccupiedBits, state.occupiedBits);
+    maxTotalOccupiedBits = std::max(maxTotalOccupiedBits, totalOccupiedBits);
+    emit(occupancySignal, totalOccupiedBits);
+    return true;
+}
+
+void SharedBufferManager::release(int queueId, int64_t bits) {
+    Enter_Method("release()");
+    QueueState& state = queues.at(queueId);
+    ASSERT(bits <= state.occupiedBits);
+
+    sharedOccupiedBits -= sharedBits(state.occupiedBits, state.reservedBits)
+            - sharedBits(state.occupiedBits - bits, state.reservedBits);
+    state.occupiedBits -= bits;
+    totalOccupiedBits -= bits;
+    emit(occupancySignal, totalOccupiedBits);
+}
+
+} // namespace nesting
@@ -0,0 +1,117 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __MAIN_SHAREDBUFFERMANAGER_H_
+#define __MAIN_SHAREDBUFFERMANAGER_H_
+
+#include <omnetpp.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "inet/common/InitStages.h"
+
+using namespace omnetpp;
+using namespace inet;
+
+namespace nesting {
+
+/**
+ * See the NED file for a detailed description.
+ */
+class SharedBufferManager: public cSimpleModule {
+protected:
+    /** Buffer accounting of a single registered queue. */
+    struct QueueState {
+        /** The registered queue module. */
+        cModule* queue;
+
+        /** Statically reserved buffer in bits. */
+        int64_t reservedBits;
+
+        /** Current buffer occupancy in bits. */
+        int64_t occupiedBits;
+
+        /** Highest buffer occupancy in bits. */
+        int64_t maxOccupiedBits;
+
+        /** Number of packets rejected by the buffer manager. */
+        long numRejected;
+    };
+
+    /** Total buffer capacity in bits. */
+    int64_t totalCapacity;
+
+    /** Factor of the dynamic threshold. */
+    double alpha;
+
+    /** Sum of all static reservations in bits. */
+    int64_t totalReservedBits = 0;
+
+    /** Bits occupied by all queues. */
+    int64_t totalOccupiedBits = 0;
+
+    /** Bits occupied by all queues beyond their static reservations. */
+    int64_t sharedOccupiedBits = 0;
+
+    /** Highest total buffer occupancy in bits. */
+    int64_t maxTotalOccupiedBits = 0;
+
+    std::vector<QueueState> queues;
+
+    simsignal_t occupancySignal;
+
+protected:
+    virtual void initialize(int stage) override;
+
+    /** @see cSimpleModule::numInitStages() */
+    virtual int numInitStages() const override;
+
+    virtual void handleMessage(cMessage* msg) override;
+
+    virtual void finish() override;
+
+    /** Returns the bits of an occupancy that exceed the reservation. */
+    static int64_t sharedBits(int64_t occupiedBits, int64_t reservedBits) {
+        return occupiedBits > reservedBits ? occupiedBits - reservedBits : 0;
+    }
+
+    /** Returns the number of bits of the shared pool that are not used. */
+    virtual int64_t freeSharedBits() const;
+
+public:
+    /**
+     * Registers a queue with a static reservation. Has to be called in
+     * initialization stage INITSTAGE_LINK_LAYER or later.
+     *
+     * @return Identifier of the queue used for allocate() and release().
+     */
+    virtual int registerQueue(cModule* queue, int64_t reservedBits);
+
+    /**
+     * Tries to allocate buffer for a packet of the given size.
+     *
+     * @return True if the packet may be stored, false if it has to be
+     *         dropped.
+     */
+    virtual bool allocate(int queueId, int64_t bits);
+
+    /** Releases buffer that was allocated with allocate(). */
+    virtual void release(int queueId, int64_t bits);
+};
+
+} // namespace nesting
+
+#endif
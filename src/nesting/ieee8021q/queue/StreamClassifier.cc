@@ -0,0 +1,130 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "StreamClassifier.h"
+
+#include <algorithm>
+
+#include "../Ieee8021q.h"
+
+namespace nesting {
+
+void StreamClassifier::load(cXMLElement* xml, int numberOfQueues) {
+    functions.clear();
+    if (xml == nullptr) {
+        return;
+    }
+
+    for (cXMLElement* stream : xml->getChildrenByTagName("stream")) {
+        const char* queueAttr = stream->getAttribute("queue");
+        if (queueAttr == nullptr) {
+            throw cRuntimeError("stream tag at %s must have a queue attribute",
+                    stream->getSourceLocation());
+        }
+        int queue = atoi(queueAttr);
+        if (queue < 0 || queue >= numberOfQueues) {
+            throw cRuntimeError(
+                    "Queue %d of stream at %s is out of range (%d queues).",
+                    queue, stream->getSourceLocation(), numberOfQueues);
+        }
+
+        addStream(stream, queue);
+    }
+}
+
+StreamClassifier::IdentificationFunction& StreamClassifier::getOrAddFunction(
+        uint64_t mask, bool sourceAddress) {
+    auto matches = [mask, sourceAddress](
+            const IdentificationFunction& function) {
+        return function.mask == mask && function.sourceAddress == sourceAddress;
+    };
+    auto it = std::find_if(functions.begin(), functions.end(), matches);
+    if (it != functions.end()) {
+        return *it;
+    }
+
+    functions.push_back( { mask, sourceAddress, FlatHashMap<int>() });
+    // Try functions using more fields first. Among functions with the same
+    // number of fields, the wider fields (address before VID before PCP) and
+    // the destination before the source are tried first.
+    std::stable_sort(functions.begin(), functions.end(),
+            [](const IdentificationFunction& a, const IdentificationFunction& b) {
+                int fieldsA = numberOfFields(a.mask);
+                int fieldsB = numberOfFields(b.mask);
+                if (fieldsA != fieldsB) {
+                    return fieldsA > fieldsB;
+                }
+                if (a.mask != b.mask) {
+                    return a.mask > b.mask;
+                }
+                return !a.sourceAddress && b.sourceAddress;
+            });
+    return *std::find_if(functions.begin(), functions.end(), matches);
+}
+
+void StreamClassifier::addStream(cXMLElement* stream, int value) {
+    const char* destAttr = stream->getAttribute("destAddress");
+    const char* sourceAttr = stream->getAttribute("sourceAddress");
+    if (destAttr != nullptr && sourceAttr != nullptr) {
+        throw cRuntimeError(
+                "stream tag at %s must not have both a destAddress and a "
+                        "sourceAddress attribute", stream->getSourceLocation());
+    }
+    uint64_t mask = 0;
+    bool sourceAddress = sourceAttr != nullptr;
+    inet::MacAddress address;
+    const char* addressAttr = destAttr != nullptr ? destAttr : sourceAttr;
+    if (addressAttr != nullptr) {
+        if (!address.tryParse(addressAttr)) {
+            throw cRuntimeError("Cannot parse MAC address %s at %s.",
+                    addressAttr, stream->getSourceLocation());
+        }
+        mask |= kAddressMask;
+    }
+
+    int vid = 0;
+    if (const char* vidAttr = stream->getAttribute("vid")) {
+        vid = atoi(vidAttr);
+        if (vid < kMinValidVID || vid > kMaxValidVID) {
+            throw cRuntimeError("Invalid VID %d at %s.", vid,
+                    stream->getSourceLocation());
+        }
+        mask |= kVidMask;
+    }
+
+    int pcp = 0;
+    if (const char* pcpAttr = stream->getAttribute("pcp")) {
+        pcp = atoi(pcpAttr);
+        if (pcp < 0 || pcp >= kNumberOfPCPValues) {
+            throw cRuntimeError("Invalid PCP %d at %s.", pcp,
+                    stream->getSourceLocation());
+        }
+        mask |= kPcpMask;
+    }
+
+    if (mask == 0) {
+        throw cRuntimeError(
+                "stream tag at %s must identify the stream by an address, "
+                        "vid or pcp attribute", stream->getSourceLocation());
+    }
+
+    uint64_t key = packKey(address, sourceAddress, vid, pcp) & mask;
+    if (!getOrAddFunction(mask, sourceAddress).streams.insert(key, value)) {
+        throw cRuntimeError("Duplicate stream at %s.",
+                stream->getSourceLocation());
+    }
+}
+
+} // namespace nesting
@@ -0,0 +1,130 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef NESTING_IEEE8021Q_QUEUE_STREAMCLASSIFIER_H_
+#define NESTING_IEEE8021Q_QUEUE_STREAMCLASSIFIER_H_
+
+#include <omnetpp.h>
+#include <vector>
+
+#include "inet/linklayer/common/MacAddress.h"
+#include "../../common/containers/FlatHashMap.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * Maps frames to queues by stream identification (IEEE 802.1CB), i.e. by
+ * destination or source MAC address, VID and PCP. The rules are read from XML
+ * once and compiled into a hash table keyed by a packed 64 bit word:
+ *
+ * <pre>
+ * | 63 .. 16 | 15                | 14 .. 3 | 2 .. 0 |
+ * | MAC      | 1 if source MAC   | VID     | PCP    |
+ * </pre>
+ *
+ * Fields a rule does not specify are masked out of the key. Every distinct
+ * combination of specified fields is one identification function with its
+ * own table, so that rules of different functions never share a key. A frame
+ * is classified with one table lookup per identification function, starting
+ * with the one using the most fields.
+ */
+class StreamClassifier {
+protected:
+    /** Combination of fields used by a set of rules. */
+    struct IdentificationFunction {
+        /** Mask of the key bits the rules specify. */
+        uint64_t mask;
+
+        /** True if the rules match the source instead of the destination. */
+        bool sourceAddress;
+
+        /** Value per masked stream key of the rules of this function. */
+        FlatHashMap<int> streams;
+    };
+
+    static const uint64_t kAddressMask = ~static_cast<uint64_t>(0) << 15;
+    static const uint64_t kVidMask = static_cast<uint64_t>(0xFFF) << 3;
+    static const uint64_t kPcpMask = 0x7;
+
+    /** Returns the number of fields (address, VID, PCP) a mask specifies. */
+    static int numberOfFields(uint64_t mask) {
+        return ((mask & kAddressMask) != 0) + ((mask & kVidMask) != 0)
+                + ((mask & kPcpMask) != 0);
+    }
+
+    /** Identification functions, most specific first. */
+    std::vector<IdentificationFunction> functions;
+
+    /**
+     * Returns the identification function for the given fields, adding it at
+     * its position in the lookup order if no rule has used it yet.
+     */
+    virtual IdentificationFunction& getOrAddFunction(uint64_t mask,
+            bool sourceAddress);
+
+public:
+    /** Packs the frame fields into a stream key. */
+    static uint64_t packKey(const inet::MacAddress& address,
+            bool sourceAddress, int vid, int pcp) {
+        return (address.getInt() << 16)
+                | (static_cast<uint64_t>(sourceAddress) << 15)
+                | (static_cast<uint64_t>(vid & 0xFFF) << 3) | (pcp & 0x7);
+    }
+
+    /**
+     * Compiles the stream rules of a \<streams\> XML element. Rule queue
+     * indices must be smaller than numberOfQueues.
+     */
+    virtual void load(cXMLElement* xml, int numberOfQueues);
+
+    /**
+     * Adds the rule of a single \<stream\> XML element. Frames of the stream
+     * are classified with the given value.
+     */
+    virtual void addStream(cXMLElement* stream, int value);
+
+    /**
+     * Returns the queue of the stream the frame belongs to, or -1 if the
+     * frame matches no stream rule.
+     */
+    int classify(const inet::MacAddress& destAddress,
+            const inet::MacAddress& sourceAddress, int vid, int pcp) const {
+        for (const IdentificationFunction& function : functions) {
+            uint64_t key = packKey(
+                    function.sourceAddress ? sourceAddress : destAddress,
+                    function.sourceAddress, vid, pcp) & function.mask;
+            const int* queue = function.streams.find(key);
+            if (queue != nullptr) {
+                return *queue;
+            }
+        }
+        return -1;
+    }
+
+    /** Returns true if no stream rules are configured. */
+    bool isEmpty() const {
+        return functions.empty();
+    }
+
+    virtual ~StreamClassifier() {
+    }
+    ;
+};
+
+} // namespace nesting
+
+#endif /* NESTING_IEEE8021Q_QUEUE_STREAMCLASSIFIER_H_ */
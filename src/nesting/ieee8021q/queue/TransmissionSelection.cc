@@ -14,6 +14,12 @@
 // 
 
 #include "../queue/TransmissionSelection.h"
+#include "SelectionCore.h"
+
+// MAC header, VLAN tag, FCS and preamble added below the queues, and the
+// interframe gap, in bits
+static const uint64_t kFrameHeaderBits = 240;
+static const uint64_t kInterframeGapBits = 96;
 
 namespace nesting {
 
@@ -24,17 +30,28 @@ TransmissionSelection::TransmissionSelection() {
     packetEnqueuedMsg.setSchedulingPriority(selfMessageSchedulingPriority);
     WATCH(packetRequestedFromUs);
     WATCH(packetRequestedFromInputs);
+    WATCH(nonEmptyMask);
+    WATCH(eligibleMask);
+    WATCH(expressMask);
+    WATCH(numBurstPackets);
 }
 
 TransmissionSelection::~TransmissionSelection() {
     cancelEvent(&requestPacketMsg);
     cancelEvent(&packetEnqueuedMsg);
+    delete selectionCore;
 }
 
 void TransmissionSelection::initialize() {
     // Get transmission gate vector module
     TransmissionGate* tgModule = getModuleFromPar<TransmissionGate>(
             par("transmissionGateVectorModule"), this);
+    if (tgModule->getVectorSize() > static_cast<int>(sizeof(unsigned int) * 8)) {
+        throw cRuntimeError(
+                "TransmissionSelection supports at most %d transmission gates.",
+                static_cast<int>(sizeof(unsigned int) * 8));
+    }
+    tGates.resize(tgModule->getVectorSize());
     // Iterate through all sibling modules
     auto it = cModule::SubmoduleIterator(tgModule->getParentModule());
     for (; !it.end(); it++) {
@@ -43,16 +60,58 @@ void TransmissionSelection::initialize() {
         // transmission-gate data-structure for easy access later on.
         if (subModule->isName(tgModule->getName())) {
             TransmissionGate* tg = check_and_cast<TransmissionGate*>(subModule);
-            tGates.push_back(tg);
+            tGates[tg->getIndex()] = tg;
         }
     }
 
+    numPacketsTransmitted.resize(tGates.size(), 0);
+    numBitsTransmitted.resize(tGates.size(), 0);
+    initializeEts();
+
+    // The specialized cores only implement strict priority among queues
+    if (par("specializedSelection") && etsMask == 0) {
+        selectionCore = createSelectionCore(tGates);
+    }
+    EV_INFO << getFullPath() << ": Using "
+                   << (selectionCore ? "specialized" : "generic")
+                   << " selection for " << tGates.size() << " queues." << endl;
+
     // so that EtherEncap does not drop packets
     llcSocket.setOutputGate(gate("eOut"));
 
     llcSocket.open(-1, ssap);
 }
 
+void TransmissionSelection::initializeEts() {
+    std::vector<int> weights = cStringTokenizer(
+            par("etsWeights").stringValue()).asIntVector();
+    if (weights.size() > tGates.size()) {
+        throw cRuntimeError("%d ETS weights given for %d queues.",
+                static_cast<int>(weights.size()),
+                static_cast<int>(tGates.size()));
+    }
+
+    int64_t quantum = par("etsQuantum");
+    if (quantum <= 0) {
+        throw cRuntimeError("Parameter etsQuantum must be positive.");
+    }
+    etsQuantum.resize(tGates.size(), 0);
+    etsDeficit.resize(tGates.size(), 0);
+    activeNext.resize(tGates.size(), kNoQueue);
+    activePrev.resize(tGates.size(), kNoQueue);
+    for (size_t i = 0; i < weights.size(); i++) {
+        if (weights[i] < 0) {
+            throw cRuntimeError("Negative ETS weight %d for queue %d.",
+                    weights[i], static_cast<int>(i));
+        } else if (weights[i] > 0) {
+            etsMask |= 1u << i;
+            etsQuantum[i] = weights[i] * quantum;
+        }
+    }
+    WATCH(etsMask);
+    WATCH(activeMask);
+}
+
 void TransmissionSelection::handleMessage(cMessage* msg) {
     if (msg->isSelfMessage()) {
         if (msg == &packetEnqueuedMsg) {
@@ -61,13 +120,7 @@ void TransmissionSelection::handleMessage(cMessage* msg) {
             handleRequestPacketEvent();
         }
     } else {
-        int gateId = -1;
-        for (unsigned int i = 0; i < tGates.size(); ++i) {
-            if (msg->arrivedOn("in", i)) {
-                gateId = i;
-                break;
-            }
-        }
+        int gateId = msg->getArrivalGate()->getIndex();
         TransmissionGate* transmissionGate = tGates.at(gateId);
         if (par("verbose")) {
             EV_DETAIL << getFullName() << ": msg arrived at gate: " << gateId
@@ -76,6 +129,8 @@ void TransmissionSelection::handleMessage(cMessage* msg) {
         }
         ASSERT(packetRequestedFromUs);
         packetRequestedFromUs = false;
+
+        packetSelected(gateId, check_and_cast<cPacket*>(msg));
         if (transmissionGate->isExpressQueue()) {
             send(msg, "eOut");
         } else {
@@ -84,6 +139,22 @@ void TransmissionSelection::handleMessage(cMessage* msg) {
     }
 }
 
+void TransmissionSelection::finish() {
+    simtime_t duration = simTime();
+    for (size_t i = 0; i < tGates.size(); i++) {
+        std::string suffix = " queue " + std::to_string(i);
+        recordScalar(("packetsTransmitted" + suffix).c_str(),
+                numPacketsTransmitted[i]);
+        recordScalar(("bitsTransmitted" + suffix).c_str(),
+                numBitsTransmitted[i]);
+        if (duration > SIMTIME_ZERO) {
+            recordScalar(("throughput" + suffix).c_str(),
+                    numBitsTransmitted[i] / duration.dbl(), "bps");
+        }
+    }
+    recordScalar("burstPackets", numBurstPackets);
+}
+
 void TransmissionSelection::refreshDisplay() const {
     char buf[80];
     sprintf(buf, "packetRequested: %s",
@@ -91,25 +162,179 @@ void TransmissionSelection::refreshDisplay() const {
     getDisplayString().setTagArg("t", 0, buf);
 }
 
+void TransmissionSelection::packetSelected(int gateIndex, cPacket* packet) {
+    int64_t bits = packet->getBitLength();
+    numPacketsTransmitted[gateIndex]++;
+    numBitsTransmitted[gateIndex] += bits;
+    if (etsMask & (1u << gateIndex)) {
+        etsDeficit[gateIndex] -= bits;
+    }
+}
+
 bool TransmissionSelection::schedulePacket() {
-    //Try to request express packet
-    for (auto it = tGates.rbegin(); it != tGates.rend(); it++) {
-        TransmissionGate* transmissionGate = *it;
-        if (transmissionGate->isExpressQueue()
-                && !transmissionGate->isEmpty()) {
-            transmissionGate->requestPacket();
-            return true;
+    TransmissionGate* transmissionGate = selectTransmissionGate();
+    if (transmissionGate == nullptr) {
+        return false;
+    } else if (isBurstCapable(transmissionGate)) {
+        // Packets are sent right away, nothing to wait for
+        sendBurst(transmissionGate);
+        packetRequestedFromUs = false;
+    } else {
+        transmissionGate->requestPacket();
+    }
+    return true;
+}
+
+bool TransmissionSelection::isBurstCapable(
+        TransmissionGate* transmissionGate) {
+    unsigned int bit = 1u << transmissionGate->getIndex();
+    return requestedBurstSize > 1 && (expressMask & bit) && !(etsMask & bit)
+            && transmissionGate->getTSAlgorithm()->isStateless();
+}
+
+void TransmissionSelection::sendBurst(TransmissionGate* transmissionGate) {
+    int gateIndex = transmissionGate->getIndex();
+    TSAlgorithm* tsAlgorithm = transmissionGate->getTSAlgorithm();
+    uint64_t stableBits = transmissionGate->stableBits();
+
+    // The first packet is selected like for a single request. The Mac module
+    // may start it up to one interframe gap from now.
+    cPacket* packet = transmissionGate->pop();
+    uint64_t usedBits = kInterframeGapBits;
+    int numPackets = 0;
+    while (true) {
+        take(packet);
+        usedBits += packet->getBitLength() + kFrameHeaderBits
+                + kInterframeGapBits;
+        packetSelected(gateIndex, packet);
+        send(packet, "eOut");
+        numPackets++;
+        // Further packets must be transmitted completely before the next
+        // gate state change
+        if (numPackets == requestedBurstSize || usedBits >= stableBits
+                || tsAlgorithm->isEmpty(stableBits - usedBits)) {
+            break;
         }
+        packet = tsAlgorithm->pop(stableBits - usedBits);
     }
+    numBurstPackets += numPackets - 1;
+}
+
+TransmissionGate* TransmissionSelection::selectTransmissionGate() {
+    unsigned int candidates = candidateMask();
+    //Try to request express packet
+    TransmissionGate* transmissionGate = selectGate(candidates & expressMask);
     //Try to request any packet
-    for (auto it = tGates.rbegin(); it != tGates.rend(); it++) {
-        TransmissionGate* transmissionGate = *it;
+    if (transmissionGate == nullptr) {
+        transmissionGate = selectGate(candidates & ~expressMask);
+    }
+    return transmissionGate;
+}
+
+unsigned int TransmissionSelection::candidateMask() const {
+    if (onHold) {
+        return eligibleMask & expressMask;
+    }
+    return eligibleMask;
+}
+
+TransmissionGate* TransmissionSelection::highestReadyGate(unsigned int mask) {
+    if (selectionCore != nullptr) {
+        int gateIndex = selectionCore->highestReadyQueue(mask, expressMask);
+        return gateIndex < 0 ? nullptr : tGates[gateIndex];
+    }
+    while (mask != 0) {
+        // Highest set bit is the highest priority candidate
+        int gateIndex = static_cast<int>(sizeof(unsigned int) * 8) - 1
+                - __builtin_clz(mask);
+        TransmissionGate* transmissionGate = tGates[gateIndex];
         if (!transmissionGate->isEmpty()) {
-            transmissionGate->requestPacket();
-            return true;
+            return transmissionGate;
+        }
+        // Candidate does not fit into the remaining gate-open time
+        mask &= ~(1u << gateIndex);
+    }
+    return nullptr;
+}
+
+TransmissionGate* TransmissionSelection::selectGate(unsigned int mask) {
+    TransmissionGate* transmissionGate = highestReadyGate(mask & ~etsMask);
+    if (transmissionGate == nullptr && (mask & etsMask) != 0) {
+        transmissionGate = selectEtsGate(mask & etsMask);
+    }
+    return transmissionGate;
+}
+
+TransmissionGate* TransmissionSelection::selectEtsGate(unsigned int mask) {
+    // Ready queues in round robin order. Queues that are not ready, e.g.
+    // because their gate is closed, keep their position and deficit.
+    int ready[sizeof(unsigned int) * 8];
+    int numReady = 0;
+    int selected = -1;
+    int64_t selectedRounds = 0;
+    for (int gateIndex = activeHead; gateIndex != kNoQueue;
+            gateIndex = activeNext[gateIndex]) {
+        if (!(mask & (1u << gateIndex)) || tGates[gateIndex]->isEmpty()) {
+            continue;
+        }
+        // Rounds until the queue has a positive deficit
+        int64_t rounds = etsDeficit[gateIndex] > 0 ?
+                0 : -etsDeficit[gateIndex] / etsQuantum[gateIndex] + 1;
+        if (selected < 0 || rounds < selectedRounds) {
+            selected = numReady;
+            selectedRounds = rounds;
+        }
+        ready[numReady++] = gateIndex;
+        if (rounds == 0) {
+            break;
+        }
+    }
+    if (selected < 0) {
+        return nullptr;
+    }
+
+    // Hand out the quanta of all rounds until the selected queue has a
+    // positive deficit at once. The ready queues ahead of it have used up
+    // their deficit in the current round as well, so they get one more
+    // quantum and move behind it.
+    for (int i = 0; i < numReady; i++) {
+        int gateIndex = ready[i];
+        int64_t rounds = i < selected ? selectedRounds + 1 : selectedRounds;
+        etsDeficit[gateIndex] += rounds * etsQuantum[gateIndex];
+        if (i < selected) {
+            deactivate(gateIndex);
+            activate(gateIndex);
         }
     }
-    return false;
+    return tGates[ready[selected]];
+}
+
+void TransmissionSelection::activate(int gateIndex) {
+    activePrev[gateIndex] = activeTail;
+    activeNext[gateIndex] = kNoQueue;
+    if (activeTail == kNoQueue) {
+        activeHead = gateIndex;
+    } else {
+        activeNext[activeTail] = gateIndex;
+    }
+    activeTail = gateIndex;
+    activeMask |= 1u << gateIndex;
+}
+
+void TransmissionSelection::deactivate(int gateIndex) {
+    int prev = activePrev[gateIndex];
+    int next = activeNext[gateIndex];
+    if (prev == kNoQueue) {
+        activeHead = next;
+    } else {
+        activeNext[prev] = next;
+    }
+    if (next == kNoQueue) {
+        activeTail = prev;
+    } else {
+        activePrev[next] = prev;
+    }
+    activeMask &= ~(1u << gateIndex);
 }
 
 void TransmissionSelection::handleRequestPacketEvent() {
@@ -159,22 +384,66 @@ void TransmissionSelection::packetEnqueued(TransmissionGate* transmissionGate) {
 
 void TransmissionSelection::requestPacket() {
     Enter_Method("requestPacket()");
+    requestPackets(1);
+}
+
+void TransmissionSelection::requestPackets(int maxPackets) {
+    Enter_Method("requestPackets()");
+    ASSERT(maxPackets > 0);
+    requestedBurstSize = maxPackets;
 
     cancelEvent(&requestPacketMsg);
     scheduleAt(simTime(), &requestPacketMsg);
 }
 
+bool TransmissionSelection::sendPacket() {
+    Enter_Method("sendPacket()");
+    ASSERT(!packetRequestedFromUs);
+
+    TransmissionGate* transmissionGate = selectTransmissionGate();
+    if (transmissionGate == nullptr) {
+        return false;
+    }
+    cPacket* packet = transmissionGate->pop();
+    take(packet);
+    packetSelected(transmissionGate->getIndex(), packet);
+    if (transmissionGate->isExpressQueue()) {
+        send(packet, "eOut");
+    } else {
+        send(packet, "pOut");
+    }
+    return true;
+}
+
 int TransmissionSelection::getNumPendingRequests() {
     return packetRequestedFromUs ? 1 : 0;
 }
 
 bool TransmissionSelection::isEmpty() {
-    for (auto transmissionGate : tGates) {
-        if (!transmissionGate->isEmpty()) {
-            return false;
+    return highestReadyGate(candidateMask()) == nullptr;
+}
+
+void TransmissionSelection::updateQueueState(int gateIndex, bool express,
+        bool nonEmpty, bool eligible) {
+    unsigned int bit = 1u << gateIndex;
+    expressMask = express ? (expressMask | bit) : (expressMask & ~bit);
+    nonEmptyMask = nonEmpty ? (nonEmptyMask | bit) : (nonEmptyMask & ~bit);
+    eligibleMask = eligible ? (eligibleMask | bit) : (eligibleMask & ~bit);
+
+    // Non-empty ETS queues take part in the round robin, a queue that became
+    // empty loses its remaining deficit
+    if (etsMask & bit) {
+        if (nonEmpty && !(activeMask & bit)) {
+            activate(gateIndex);
+        } else if (!nonEmpty && (activeMask & bit)) {
+            deactivate(gateIndex);
+            etsDeficit[gateIndex] = 0;
         }
     }
-    return true;
+}
+
+void TransmissionSelection::holdStateChanged(bool onHold) {
+    this->onHold = onHold;
 }
 
 void TransmissionSelection::removePendingRequests() {
@@ -187,7 +456,16 @@ void TransmissionSelection::clear() {
 }
 
 cMessage* TransmissionSelection::pop() {
-    throw cRuntimeError("Unsupported operation");
+    Enter_Method("pop()");
+    ASSERT(!packetRequestedFromUs);
+
+    TransmissionGate* transmissionGate = selectTransmissionGate();
+    if (transmissionGate == nullptr) {
+        return nullptr;
+    }
+    cPacket* packet = transmissionGate->pop();
+    packetSelected(transmissionGate->getIndex(), packet);
+    return packet;
 }
 
 void TransmissionSelection::addListener(IPassiveQueueListener *listener) {
@@ -206,13 +484,11 @@ void TransmissionSelection::notifyPacketEnqueued() {
 }
 
 bool TransmissionSelection::hasExpressPacketEnqueued() {
-    for (auto transmissionGate : tGates) {
-        if (transmissionGate->isExpressQueue()
-                && !transmissionGate->isEmpty()) {
-            return true;
-        }
-    }
-    return false;
+    return highestReadyGate(eligibleMask & expressMask) != nullptr;
+}
+
+bool TransmissionSelection::hasPreemptablePacketEnqueued() {
+    return (eligibleMask & ~expressMask) != 0;
 }
 
 } // namespace nesting
@@ -31,12 +31,15 @@ using namespace inet;
 namespace nesting {
 
 class TransmissionGate;
+class ISelectionCore;
 
 /**
  * See the NED file for a detailed description.
  */
 class TransmissionSelection: public IPassiveQueue, public cSimpleModule {
 protected:
+    static const int kNoQueue = -1;
+
     /**
      * This data-structure keeps references to the transmission-gates that
      * serve as input modules. The gate with the highest index is the highest
@@ -45,6 +48,72 @@ protected:
      */
     std::vector<TransmissionGate*> tGates;
 
+    /**
+     * Bitmask of the input queues that currently hold at least one frame. Bit
+     * i corresponds to the transmission gate with index i.
+     */
+    unsigned int nonEmptyMask = 0;
+
+    /**
+     * Bitmask of the input queues that hold a frame, whose transmission gate
+     * is open and whose transmission-selection-algorithm currently allows
+     * transmission. The length-aware check against the remaining gate-open
+     * time depends on the current time and is therefore only done for these
+     * candidates on selection.
+     */
+    unsigned int eligibleMask = 0;
+
+    /** Bitmask of the input queues that are express queues. */
+    unsigned int expressMask = 0;
+
+    /**
+     * Selection core specialized for the number of queues and their
+     * transmission selection algorithms, or nullptr if the generic selection
+     * over tGates is used.
+     */
+    ISelectionCore* selectionCore = nullptr;
+
+    /**
+     * Bitmask of the input queues that share the bandwidth left by the strict
+     * priority queues by deficit round robin (enhanced transmission
+     * selection).
+     */
+    unsigned int etsMask = 0;
+
+    /** Deficit added per round to each ETS queue, in bits. */
+    std::vector<int64_t> etsQuantum;
+
+    /**
+     * Deficit of each ETS queue in bits. A queue is served while its deficit
+     * is positive and the bits of every transmitted frame are subtracted
+     * afterwards, so that the frame size need not be known on selection.
+     */
+    std::vector<int64_t> etsDeficit;
+
+    /**
+     * Active list of the non-empty ETS queues in round robin order, as a
+     * doubly linked list over the queue indices. kNoQueue terminates it.
+     */
+    std::vector<int> activeNext;
+    std::vector<int> activePrev;
+    int activeHead = kNoQueue;
+    int activeTail = kNoQueue;
+
+    /** Bitmask of the queues in the active list. */
+    unsigned int activeMask = 0;
+
+    /** Number of transmitted frames per input queue. */
+    std::vector<long> numPacketsTransmitted;
+
+    /** Number of transmitted bits per input queue. */
+    std::vector<uint64_t> numBitsTransmitted;
+
+    /**
+     * True if the Mac module is on hold, which means only express queues are
+     * allowed to transmit.
+     */
+    bool onHold = false;
+
     /**
      * This vector keeps references to listeners that are notified about
      * packet-enqueued-events. In the default case this should be the Mac
@@ -66,6 +135,15 @@ protected:
      */
     bool packetRequestedFromInputs = false;
 
+    /**
+     * Maximum number of packets that may be sent out for the pending request,
+     * see requestPackets(int).
+     */
+    int requestedBurstSize = 1;
+
+    /** Number of packets sent as part of a burst after its first packet. */
+    long numBurstPackets = 0;
+
     /**
      * Set a lower scheduling priority for self-messages than the default
      * value of zero. It is important, that internal events when concurrently
@@ -109,15 +187,82 @@ protected:
      */
     virtual void refreshDisplay() const override;
 
+    /**
+     * @see cSimpleModule::finish()
+     */
+    virtual void finish() override;
+
+    /** Parses the ETS weights and sets up the deficit round robin state. */
+    virtual void initializeEts();
+
     /**
      * This method tries to request a packet from the highest priority input
      * module (transmission gate). If no packet is available for transmission,
-     * no packet is requested.
+     * no packet is requested. If the input module allows it, a burst of
+     * packets is sent out right away instead, see sendBurst().
      *
-     * @return True if a packet was requested, false otherwise.
+     * @return True if a packet was requested or sent, false otherwise.
      */
     virtual bool schedulePacket();
 
+    /**
+     * Takes up to requestedBurstSize packets from a transmission gate and
+     * sends them out at once. Packets after the first one are only taken if
+     * they are transmitted completely before any gate state changes.
+     */
+    virtual void sendBurst(TransmissionGate* transmissionGate);
+
+    /**
+     * Returns true if packets of a transmission gate may be sent as a burst:
+     * a burst was requested, and the queue is an express queue that is not
+     * an ETS queue and whose transmission selection algorithm is stateless.
+     */
+    virtual bool isBurstCapable(TransmissionGate* transmissionGate);
+
+    /**
+     * Returns the transmission gate to take the next packet from, or nullptr
+     * if no packet is ready for transmission. Express queues are preferred.
+     */
+    virtual TransmissionGate* selectTransmissionGate();
+
+    /**
+     * Updates the per-queue statistics and the ETS deficit for a packet that
+     * leaves through this module.
+     */
+    virtual void packetSelected(int gateIndex, cPacket* packet);
+
+    /**
+     * Returns the bitmask of input queues that are candidates for
+     * transmission, considering the current hold state.
+     */
+    virtual unsigned int candidateMask() const;
+
+    /**
+     * Returns the highest priority transmission gate out of a bitmask of
+     * candidates that has a packet ready for transmission, or nullptr if there
+     * is none. Candidates are visited from the highest set bit downwards.
+     */
+    virtual TransmissionGate* highestReadyGate(unsigned int mask);
+
+    /**
+     * Selects the transmission gate to request a packet from out of a bitmask
+     * of candidates. Strict priority queues are served first, the remaining
+     * bandwidth is shared by the ETS queues.
+     */
+    virtual TransmissionGate* selectGate(unsigned int mask);
+
+    /**
+     * Selects an ETS queue out of a bitmask of candidates by deficit round
+     * robin, or returns nullptr if none has a packet ready for transmission.
+     */
+    virtual TransmissionGate* selectEtsGate(unsigned int mask);
+
+    /** Appends a queue to the end of the active list. */
+    virtual void activate(int gateIndex);
+
+    /** Removes a queue from the active list. */
+    virtual void deactivate(int gateIndex);
+
     /**
      * This method handles a request-packet-event. This means possibly
      * requesting a packet from one of the input modules or if that is not
@@ -147,11 +292,41 @@ public:
      */
     virtual void packetEnqueued(TransmissionGate* transmissioGate);
 
+    /**
+     * This method is called by a transmission gate whenever the queue state
+     * behind it changed, e.g. due to enqueue, dequeue, gate or credit
+     * changes. It updates the selection bitmasks in constant time.
+     */
+    virtual void updateQueueState(int gateIndex, bool express, bool nonEmpty,
+            bool eligible);
+
+    /**
+     * This method is called by the Mac module when the hold state changes.
+     */
+    virtual void holdStateChanged(bool onHold);
+
     /**
      * @see IPassiveQueue::requestPacket()
      */
     virtual void requestPacket() override;
 
+    /**
+     * Requests up to maxPackets packets at once. Like for requestPacket(),
+     * only one request may be pending. Packets beyond the first one are only
+     * sent in bursts, see sendBurst(), so the Mac module must be able to
+     * receive several packets while it is transmitting.
+     */
+    virtual void requestPackets(int maxPackets);
+
+    /**
+     * Selects the next packet like requestPacket() and sends it out within
+     * the current event, i.e. without the request events through the
+     * transmission gate, the transmission selection algorithm and the queue.
+     * Returns false if no packet is ready, no request is left pending then.
+     * Must not be called while a packet request is pending.
+     */
+    virtual bool sendPacket();
+
     /**
      * @see IPassiveQueue::getNumPendingRequests()
      */
@@ -168,6 +343,11 @@ public:
     virtual void clear() override;
 
     /**
+     * Removes and returns the next packet for transmission directly, without
+     * the events of requestPacket(), or nullptr if no packet is ready. Must
+     * not be called while a packet request is pending. The caller has to
+     * take ownership of the packet.
+     *
      * @see IPassiveQueue::pop()
      */
     virtual cMessage *pop() override;
@@ -184,6 +364,13 @@ public:
 
     virtual bool hasExpressPacketEnqueued();
 
+    /**
+     * Returns true if a preemptable queue holds a frame that is eligible for
+     * transmission apart from a hold of the Mac module. Unlike isEmpty(), the
+     * remaining gate-open time is not checked.
+     */
+    virtual bool hasPreemptablePacketEnqueued();
+
     virtual void removePendingRequests();
 };
 
@@ -0,0 +1,153 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <sstream>
+
+#include "FrameRingBuffer.h"
+
+namespace nesting {
+
+FrameRingBuffer::FrameRingBuffer(const char* name, size_t initialCapacity) :
+        cOwnedObject(name, false) {
+    size_t capacity = 1;
+    while (capacity < initialCapacity) {
+        capacity *= 2;
+    }
+    entries.resize(capacity);
+}
+
+FrameRingBuffer::~FrameRingBuffer() {
+    clear();
+}
+
+void FrameRingBuffer::grow() {
+    std::vector<Entry> grown(entries.size() * 2);
+    size_t index = 0;
+    for (size_t i = 0; i < usedSlots; i++) {
+        if (slot(i).packet != nullptr) {
+            grown[index++] = slot(i);
+        }
+    }
+    entries.swap(grown);
+    head = 0;
+    usedSlots = index;
+}
+
+void FrameRingBuffer::compact() {
+    // The write offset never passes the read offset, so no packet is
+    // overwritten before it has been moved.
+    size_t index = 0;
+    for (size_t i = 0; i < usedSlots; i++) {
+        if (slot(i).packet != nullptr) {
+            slot(index++) = slot(i);
+        }
+    }
+    for (size_t i = index; i < usedSlots; i++) {
+        slot(i).packet = nullptr;
+    }
+    usedSlots = index;
+}
+
+void FrameRingBuffer::trim() {
+    while (usedSlots > 0 && slot(0).packet == nullptr) {
+        head = (head + 1) & (entries.size() - 1);
+        usedSlots--;
+    }
+    while (usedSlots > 0 && slot(usedSlots - 1).packet == nullptr) {
+        usedSlots--;
+    }
+}
+
+void FrameRingBuffer::insert(cPacket* packet) {
+    ASSERT(packet != nullptr);
+    if (usedSlots == entries.size()) {
+        // Packets removed from the middle leave holes behind a stuck head.
+        // Reclaim them if they make up at least half of the buffer, and only
+        // grow if the buffer is mostly full of packets.
+        if (static_cast<size_t>(length) * 2 <= entries.size()) {
+            compact();
+        } else {
+            grow();
+        }
+    }
+    take(packet);
+    slot(usedSlots++) = {packet, packet->getBitLength()};
+    length++;
+}
+
+cPacket* FrameRingBuffer::pop() {
+    if (length == 0) {
+        return nullptr;
+    }
+    cPacket* packet = slot(0).packet;
+    slot(0).packet = nullptr;
+    length--;
+    trim();
+    drop(packet);
+    return packet;
+}
+
+cPacket* FrameRingBuffer::remove(cPacket* packet) {
+    for (size_t i = 0; i < usedSlots; i++) {
+        if (slot(i).packet == packet) {
+            slot(i).packet = nullptr;
+            length--;
+            trim();
+            drop(packet);
+            return packet;
+        }
+    }
+    return nullptr;
+}
+
+bool FrameRingBuffer::contains(cPacket* packet) const {
+    for (size_t i = 0; i < usedSlots; i++) {
+        if (slot(i).packet == packet) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FrameRingBuffer::clear() {
+    for (size_t i = 0; i < usedSlots; i++) {
+        if (slot(i).packet != nullptr) {
+            dropAndDelete(slot(i).packet);
+            slot(i).packet = nullptr;
+        }
+    }
+    head = 0;
+    usedSlots = 0;
+    length = 0;
+}
+
+void FrameRingBuffer::forEachChild(cVisitor* v) {
+    for (size_t i = 0; i < usedSlots; i++) {
+        if (slot(i).packet != nullptr) {
+            v->visit(slot(i).packet);
+        }
+    }
+}
+
+std::string FrameRingBuffer::str() const {
+    if (length == 0) {
+        return std::string("empty");
+    }
+    std::stringstream out;
+    out << "len=" << length;
+    return out.str();
+}
+
+} // namespace nesting
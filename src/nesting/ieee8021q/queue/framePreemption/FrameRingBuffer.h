@@ -0,0 +1,132 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef NESTING_IEEE8021Q_QUEUE_FRAMEPREEMPTION_FRAMERINGBUFFER_H_
+#define NESTING_IEEE8021Q_QUEUE_FRAMEPREEMPTION_FRAMERINGBUFFER_H_
+
+#include <omnetpp.h>
+#include <vector>
+#include <string>
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * FIFO of packets stored in a growable ring buffer. The bit length of every
+ * packet is cached next to its pointer, so that the head of the queue can be
+ * checked against a maximum transmission size without touching the packet.
+ * Once the buffer has grown to the maximum queue length, inserting and
+ * removing packets does not allocate memory.
+ *
+ * The buffer takes ownership of its packets, so they are shown as children of
+ * the buffer in the inspectors.
+ *
+ * Packets can also be removed from the middle of the buffer. Their slots are
+ * left empty and skipped when the head of the buffer advances.
+ */
+class FrameRingBuffer: public cOwnedObject {
+protected:
+    struct Entry {
+        /** Packet of the slot, or nullptr for a removed packet. */
+        cPacket* packet;
+
+        /** Cached bit length of the packet. */
+        int64_t bitLength;
+    };
+
+    /** Slots of the ring buffer. The size is always a power of two. */
+    std::vector<Entry> entries;
+
+    /** Index of the head slot. */
+    size_t head = 0;
+
+    /** Number of used slots, including removed packets. */
+    size_t usedSlots = 0;
+
+    /** Number of packets. */
+    int length = 0;
+
+protected:
+    /** Returns the slot at the given offset from the head. */
+    Entry& slot(size_t offset) {
+        return entries[(head + offset) & (entries.size() - 1)];
+    }
+    const Entry& slot(size_t offset) const {
+        return entries[(head + offset) & (entries.size() - 1)];
+    }
+
+    /** Doubles the number of slots and compacts the packets. */
+    virtual void grow();
+
+    /**
+     * Moves the packets towards the head to close the slots of removed
+     * packets, without allocating memory.
+     */
+    virtual void compact();
+
+    /** Frees empty slots at the head and the tail of the buffer. */
+    virtual void trim();
+
+public:
+    explicit FrameRingBuffer(const char* name = nullptr,
+            size_t initialCapacity = 16);
+
+    virtual ~FrameRingBuffer();
+
+    /** Appends a packet and takes ownership of it. */
+    virtual void insert(cPacket* packet);
+
+    /** Returns the oldest packet, or nullptr if the buffer is empty. */
+    cPacket* front() const {
+        return length > 0 ? slot(0).packet : nullptr;
+    }
+
+    /** Returns the bit length of the oldest packet. */
+    int64_t frontBitLength() const {
+        ASSERT(length > 0);
+        return slot(0).bitLength;
+    }
+
+    /** Removes the oldest packet and releases ownership of it. */
+    virtual cPacket* pop();
+
+    /** Removes the given packet and releases ownership of it. */
+    virtual cPacket* remove(cPacket* packet);
+
+    /** Returns true if the buffer holds the given packet. */
+    virtual bool contains(cPacket* packet) const;
+
+    int getLength() const {
+        return length;
+    }
+
+    bool isEmpty() const {
+        return length == 0;
+    }
+
+    /** Deletes all packets. */
+    virtual void clear();
+
+    /** @see cObject::forEachChild() */
+    virtual void forEachChild(cVisitor* v) override;
+
+    /** @see cObject::str() */
+    virtual std::string str() const override;
+};
+
+} // namespace nesting
+
+#endif /* NESTING_IEEE8021Q_QUEUE_FRAMEPREEMPTION_FRAMERINGBUFFER_H_ */
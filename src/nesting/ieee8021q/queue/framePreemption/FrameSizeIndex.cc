@@ -0,0 +1,129 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <algorithm>
+
+#include "FrameSizeIndex.h"
+
+namespace nesting {
+
+FrameSizeIndex::FrameSizeIndex(int64_t bucketBits,
+        unsigned int numberOfBuckets) :
+        bucketBits(bucketBits) {
+    ASSERT(bucketBits > 0 && numberOfBuckets > 0);
+    numberOfLeaves = 1;
+    while (numberOfLeaves < numberOfBuckets) {
+        numberOfLeaves *= 2;
+    }
+    buckets.resize(numberOfBuckets);
+    tree.assign(2 * numberOfLeaves, -1);
+}
+
+unsigned int FrameSizeIndex::bucketOf(int64_t bitLength) const {
+    int64_t bucket = bitLength / bucketBits;
+    if (bucket >= static_cast<int64_t>(buckets.size())) {
+        return buckets.size() - 1;
+    }
+    return static_cast<unsigned int>(bucket);
+}
+
+int FrameSizeIndex::older(int bucketA, int bucketB) const {
+    if (bucketA < 0) {
+        return bucketB;
+    } else if (bucketB < 0) {
+        return bucketA;
+    }
+    return buckets[bucketA].front().sequenceNumber
+            < buckets[bucketB].front().sequenceNumber ? bucketA : bucketB;
+}
+
+void FrameSizeIndex::updateBucket(unsigned int bucket) {
+    unsigned int node = numberOfLeaves + bucket;
+    tree[node] = buckets[bucket].empty() ? -1 : static_cast<int>(bucket);
+    for (node /= 2; node >= 1; node /= 2) {
+        tree[node] = older(tree[2 * node], tree[2 * node + 1]);
+    }
+}
+
+int FrameSizeIndex::oldestBucketUpTo(unsigned int lastBucket) const {
+    int result = -1;
+    unsigned int left = numberOfLeaves;
+    unsigned int right = numberOfLeaves + lastBucket + 1;
+    while (left < right) {
+        if (left & 1) {
+            result = older(result, tree[left++]);
+        }
+        if (right & 1) {
+            result = older(result, tree[--right]);
+        }
+        left /= 2;
+        right /= 2;
+    }
+    return result;
+}
+
+void FrameSizeIndex::insert(cPacket* packet) {
+    unsigned int bucket = bucketOf(packet->getBitLength());
+    buckets[bucket].push_back( { nextSequenceNumber++, packet });
+    // Only a new head changes the tree
+    if (buckets[bucket].size() == 1) {
+        updateBucket(bucket);
+    }
+}
+
+void FrameSizeIndex::remove(cPacket* packet) {
+    unsigned int bucket = bucketOf(packet->getBitLength());
+    std::deque<Entry>& entries = buckets[bucket];
+    ASSERT(!entries.empty());
+    if (entries.front().packet == packet) {
+        entries.pop_front();
+        updateBucket(bucket);
+        return;
+    }
+    // The head is unchanged, so is the tree.
+    auto it = std::find_if(entries.begin(), entries.end(),
+            [packet](const Entry& entry) {return entry.packet == packet;});
+    ASSERT(it != entries.end());
+    entries.erase(it);
+}
+
+cPacket* FrameSizeIndex::oldestFitting(int64_t maxPacketBits) const {
+    if (maxPacketBits < 0) {
+        return nullptr;
+    }
+    // All packets in the buckets below the boundary bucket fit.
+    unsigned int boundaryBucket = bucketOf(maxPacketBits);
+    const Entry* result = nullptr;
+    if (boundaryBucket > 0) {
+        int bucket = oldestBucketUpTo(boundaryBucket - 1);
+        if (bucket >= 0) {
+            result = &buckets[bucket].front();
+        }
+    }
+    // The boundary bucket holds packets on both sides of maxPacketBits. Its
+    // first fitting packet is only a better result if it is older.
+    for (const Entry& entry : buckets[boundaryBucket]) {
+        if (result != nullptr && entry.sequenceNumber > result->sequenceNumber) {
+            break;
+        }
+        if (entry.packet->getBitLength() <= maxPacketBits) {
+            result = &entry;
+            break;
+        }
+    }
+    return result == nullptr ? nullptr : result->packet;
+}
+
+} // namespace nesting
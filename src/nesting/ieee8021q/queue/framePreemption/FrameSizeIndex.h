@@ -0,0 +1,113 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef NESTING_IEEE8021Q_QUEUE_FRAMEPREEMPTION_FRAMESIZEINDEX_H_
+#define NESTING_IEEE8021Q_QUEUE_FRAMEPREEMPTION_FRAMESIZEINDEX_H_
+
+#include <omnetpp.h>
+#include <deque>
+#include <vector>
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * Index over the packets of a queue, bucketed by packet size. Every bucket is
+ * a FIFO of packets ordered by their sequence number (arrival order). A
+ * segment tree over the buckets keeps the bucket with the oldest head packet
+ * for every range, so that the oldest packet of all buckets entirely below a
+ * given size can be found in O(log b) for b buckets. Only the bucket that
+ * contains the size boundary is scanned packet by packet.
+ *
+ * Packets can be removed from anywhere in their bucket, e.g. by a
+ * transmission selection algorithm that picks its own packet. Removing the
+ * head of a bucket is the cheap case.
+ */
+class FrameSizeIndex {
+protected:
+    struct Entry {
+        /** Arrival order of the packet within the queue. */
+        uint64_t sequenceNumber;
+
+        cPacket* packet;
+    };
+
+    /** Size of a bucket in bits. */
+    const int64_t bucketBits;
+
+    /** Number of leaves of the segment tree, a power of two. */
+    unsigned int numberOfLeaves;
+
+    /** Sequence number assigned to the next inserted packet. */
+    uint64_t nextSequenceNumber = 0;
+
+    /** Packets per size bucket in arrival order. */
+    std::vector<std::deque<Entry>> buckets;
+
+    /**
+     * Segment tree over the buckets. Every node holds the index of the bucket
+     * with the oldest head packet in its range, or -1 if the range is empty.
+     */
+    std::vector<int> tree;
+
+protected:
+    /** Returns the bucket index for a packet of the given size. */
+    virtual unsigned int bucketOf(int64_t bitLength) const;
+
+    /**
+     * Returns the older one of two buckets by their head packets. Empty
+     * buckets are represented by -1.
+     */
+    virtual int older(int bucketA, int bucketB) const;
+
+    /** Updates the tree nodes on the path from a bucket to the root. */
+    virtual void updateBucket(unsigned int bucket);
+
+    /** Returns the bucket with the oldest head packet in [0, lastBucket]. */
+    virtual int oldestBucketUpTo(unsigned int lastBucket) const;
+public:
+    /**
+     * @param bucketBits      Size of a bucket in bits.
+     * @param numberOfBuckets Number of buckets. Packets larger than the range
+     *                        covered by all buckets go to the last bucket.
+     */
+    FrameSizeIndex(int64_t bucketBits, unsigned int numberOfBuckets);
+
+    virtual ~FrameSizeIndex() {
+    }
+    ;
+
+    /** Adds a packet as the newest packet of the index. */
+    virtual void insert(cPacket* packet);
+
+    /**
+     * Removes a packet from the index. Packets other than the oldest packet
+     * of their size bucket are searched linearly within the bucket.
+     */
+    virtual void remove(cPacket* packet);
+
+    /**
+     * Returns the oldest packet with a bit length of at most maxPacketBits, or
+     * nullptr if there is none. The bucket containing maxPacketBits is
+     * scanned in arrival order until a fitting packet is found or its packets
+     * are younger than the oldest packet of the smaller buckets.
+     */
+    virtual cPacket* oldestFitting(int64_t maxPacketBits) const;
+};
+
+} // namespace nesting
+
+#endif /* NESTING_IEEE8021Q_QUEUE_FRAMEPREEMPTION_FRAMESIZEINDEX_H_ */
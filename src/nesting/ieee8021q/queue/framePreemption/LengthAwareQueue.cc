@@ -17,97 +17,217 @@
 
 namespace nesting {
 
+// Account for headers (30 bytes * 8) not included in the queued packets.
+static const uint64_t kFrameHeaderBits = 240;
+
+// The size index covers packets up to 2048 bytes in 32 byte steps.
+static const int64_t kSizeIndexBucketBits = 32 * 8;
+static const unsigned int kSizeIndexNumberOfBuckets = 64;
+
 Define_Module(LengthAwareQueue);
 
 LengthAwareQueue::~LengthAwareQueue() {
     cancelEvent(&requestPacketMsg);
-    while (!queue.isEmpty()) {
-        delete queue.pop();
-    }
+    cancelEvent(&statisticsSampleMsg);
     queue.clear();
+    delete sizeIndex;
 }
 
-void LengthAwareQueue::initialize() {
-    rcvdPkSignal = registerSignal("rcvdPk");
-    enqueuePkSignal = registerSignal("enqueuePk");
-    dequeuePkSignal = registerSignal("dequeuePk");
-    dropPkByQueueSignal = registerSignal("dropPkByQueue");
-    queueingTimeSignal = registerSignal("queueingTime");
-    queueLengthSignal = registerSignal("queueLength");
+void LengthAwareQueue::initialize(int stage) {
+    if (stage == INITSTAGE_LOCAL) {
+        rcvdPkSignal = registerSignal("rcvdPk");
+        enqueuePkSignal = registerSignal("enqueuePk");
+        dequeuePkSignal = registerSignal("dequeuePk");
+        dropPkByQueueSignal = registerSignal("dropPkByQueue");
+        queueingTimeSignal = registerSignal("queueingTime");
+        queueLengthSignal = registerSignal("queueLength");
+        bestFitPkSignal = registerSignal("bestFitPk");
+        sampledQueueLengthSignal = registerSignal("sampledQueueLength");
+        sampledQueueingTimeSignal = registerSignal("sampledQueueingTime");
+
+        queue.setName(par("queueName"));
+        availableBufferCapacity = par("bufferCapacity");
+        expressQueue = par("expressQueue");
+        bestFitSelection = par("bestFitSelection");
+        if (bestFitSelection) {
+            sizeIndex = new FrameSizeIndex(kSizeIndexBucketBits,
+                    kSizeIndexNumberOfBuckets);
+        }
+        WATCH(numPacketsReceived);
+        WATCH(numPacketsDropped);
+        WATCH(numPacketsEnqueued);
+        WATCH(availableBufferCapacity);
+        WATCH(numPacketsBestFit);
 
-    queue.setName(par("queueName"));
-    availableBufferCapacity = par("bufferCapacity");
-    expressQueue = par("expressQueue");
-    WATCH(numPacketsReceived);
-    WATCH(numPacketsDropped);
-    WATCH(numPacketsEnqueued);
-    WATCH(availableBufferCapacity);
+        aggregateStatistics = par("aggregateStatistics");
+        statisticsSamplingInterval = par("statisticsSamplingInterval");
+        if (statisticsSamplingInterval < SIMTIME_ZERO) {
+            throw cRuntimeError(
+                    "Parameter statisticsSamplingInterval must not be negative.");
+        }
+        queueingTimeHistogram.setName("aggregated:queueingTime");
+        lastQueueLengthChange = simTime();
+        lastStatisticsSample = simTime();
+        if (aggregateStatistics && statisticsSamplingInterval > SIMTIME_ZERO) {
+            scheduleAt(simTime() + statisticsSamplingInterval,
+                    &statisticsSampleMsg);
+        }
 
-    // module references
-    tsAlgorithm = getModuleFromPar<TSAlgorithm>(
-            par("transmissionSelectionAlgorithmModule"), this);
+        // module references
+        tsAlgorithm = getModuleFromPar<TSAlgorithm>(
+                par("transmissionSelectionAlgorithmModule"), this);
 
-    // statistics
-    emit(queueLengthSignal, queue.getLength());
+        // statistics
+        queueLengthChanged();
+    }
+    // register at the shared buffer after it has read its capacity
+    else if (stage == INITSTAGE_LINK_LAYER) {
+        if (strlen(par("sharedBufferModule").stringValue()) > 0) {
+            sharedBuffer = getModuleFromPar<SharedBufferManager>(
+                    par("sharedBufferModule"), this);
+            sharedBufferQueueId = sharedBuffer->registerQueue(this,
+                    par("bufferReservation").intValue());
+        }
+    }
+}
+
+int LengthAwareQueue::numInitStages() const {
+    return INITSTAGE_LINK_LAYER + 1;
 }
 
 void LengthAwareQueue::handleMessage(cMessage* msg) {
     if (msg->isSelfMessage()) {
         if (msg == &requestPacketMsg) {
             handleRequestPacketEvent(maxTransmittableBits);
+        } else if (msg == &statisticsSampleMsg) {
+            handleStatisticsSampleEvent();
         }
     } else {
         cPacket* packet = check_and_cast<cPacket*>(msg);
-        emit(rcvdPkSignal, packet);
+        if (!aggregateStatistics) {
+            emit(rcvdPkSignal, packet);
+        }
         numPacketsReceived++;
         enqueue(packet);
     }
 }
 
 void LengthAwareQueue::enqueue(cPacket* packet) {
-    if (availableBufferCapacity >= packet->getBitLength()) {
-        emit(enqueuePkSignal, packet);
+    bool admitted = allocateBuffer(packet);
+    if (admitted && !tsAlgorithm->admitPacket(packet)) {
+        releaseBuffer(packet);
+        admitted = false;
+    }
+    if (admitted) {
+        if (!aggregateStatistics) {
+            emit(enqueuePkSignal, packet);
+        }
         numPacketsEnqueued++;
         queue.insert(packet);
-        availableBufferCapacity -= packet->getBitLength();
+        if (sizeIndex) {
+            sizeIndex->insert(packet);
+        }
+        tsAlgorithm->queueStateChanged();
         handlePacketEnqueuedEvent(packet);
     } else {
-        emit(dropPkByQueueSignal, packet);
+        if (!aggregateStatistics) {
+            emit(dropPkByQueueSignal, packet);
+        }
         numPacketsDropped++;
         handlePacketEnqueuedEvent(packet);
         delete packet;
     }
-    emit(queueLengthSignal, queue.getLength());
+    queueLengthChanged();
 }
 
-cPacket* LengthAwareQueue::dequeue() {
-    if (queue.isEmpty()) {
-        return nullptr;
+cPacket* LengthAwareQueue::dequeue(cPacket* packet) {
+    ASSERT(queue.contains(packet));
+
+    queue.remove(packet);
+    if (sizeIndex) {
+        sizeIndex->remove(packet);
     }
+    releaseBuffer(packet);
+    tsAlgorithm->queueStateChanged();
 
-    cPacket* packet = static_cast<cPacket*>(queue.pop());
-    availableBufferCapacity += packet->getBitLength();
-    
-    emit(queueLengthSignal, queue.getLength());
+    queueLengthChanged();
 
     return packet;
 }
 
+bool LengthAwareQueue::allocateBuffer(cPacket* packet) {
+    if (sharedBuffer) {
+        return sharedBuffer->allocate(sharedBufferQueueId,
+                packet->getBitLength());
+    } else if (availableBufferCapacity < packet->getBitLength()) {
+        return false;
+    }
+    availableBufferCapacity -= packet->getBitLength();
+    return true;
+}
+
+void LengthAwareQueue::releaseBuffer(cPacket* packet) {
+    if (sharedBuffer) {
+        sharedBuffer->release(sharedBufferQueueId, packet->getBitLength());
+    } else {
+        availableBufferCapacity += packet->getBitLength();
+    }
+}
+
+cPacket* LengthAwareQueue::selectPacket(uint64_t maxBits) {
+    if (queue.isEmpty() || maxBits < kFrameHeaderBits) {
+        return nullptr;
+    }
+
+    uint64_t maxPacketBits = maxBits - kFrameHeaderBits;
+    if (static_cast<uint64_t>(queue.frontBitLength()) <= maxPacketBits) {
+        return queue.front();
+    } else if (sizeIndex) {
+        return sizeIndex->oldestFitting(maxPacketBits);
+    }
+    return nullptr;
+}
+
 void LengthAwareQueue::handleRequestPacketEvent(uint64_t maxBits) {
-    ASSERT(!isEmpty(maxBits));
+    cPacket* packet = requestedPacket;
+    requestedPacket = nullptr;
+    send(takePacket(maxBits, packet), "out");
+}
 
-    cPacket* nextPacket = static_cast<cPacket*>(queue.front());
-    EV_TRACE << getFullPath() << ": Packet requested with max length of "
-                    << maxBits << "bits. Next packet has "
-                    << static_cast<uint64_t>(nextPacket->getBitLength())
-                    << "bits." << endl;
+cPacket* LengthAwareQueue::takePacket(uint64_t maxBits, cPacket* packetToSend) {
+    if (packetToSend != nullptr) {
+        EV_TRACE << getFullPath() << ": Packet with "
+                        << static_cast<uint64_t>(packetToSend->getBitLength())
+                        << "bits requested by the transmission selection "
+                        << "algorithm." << endl;
+    } else {
+        ASSERT(!isEmpty(maxBits));
+
+        cPacket* nextPacket = queue.front();
+        EV_TRACE << getFullPath() << ": Packet requested with max length of "
+                        << maxBits << "bits. Next packet has "
+                        << static_cast<uint64_t>(nextPacket->getBitLength())
+                        << "bits." << endl;
+
+        packetToSend = selectPacket(maxBits);
+        if (packetToSend != nextPacket) {
+            EV_TRACE << getFullPath() << ": Best-fit selection of packet with "
+                            << static_cast<uint64_t>(packetToSend->getBitLength())
+                            << "bits." << endl;
+            numPacketsBestFit++;
+            if (!aggregateStatistics) {
+                emit(bestFitPkSignal, packetToSend);
+            }
+        }
+    }
+    dequeue(packetToSend);
 
-    cPacket* packetToSend = dequeue();
+    if (!aggregateStatistics) {
+        emit(dequeuePkSignal, packetToSend);
+    }
+    recordQueueingTime(simTime() - packetToSend->getArrivalTime());
 
-    emit(dequeuePkSignal, packetToSend);
-    emit(queueingTimeSignal, simTime() - packetToSend->getArrivalTime());
-    
-    send(packetToSend, "out");
+    return packetToSend;
 }
 
 void LengthAwareQueue::handlePacketEnqueuedEvent(cPacket* packet) {
@@ -115,21 +235,143 @@ void LengthAwareQueue::handlePacketEnqueuedEvent(cPacket* packet) {
     tsAlgorithm->packetEnqueued();
 }
 
-bool LengthAwareQueue::isEmpty(uint64_t maxBits) {
-    if (queue.isEmpty()) {
-        return true;
+void LengthAwareQueue::finish() {
+    recordScalar("bestFitSelection", bestFitSelection);
+    recordScalar("bestFitPackets", numPacketsBestFit);
+
+    if (aggregateStatistics) {
+        integrateQueueLength();
+        simtime_t duration = simTime();
+        recordScalar("aggregated:rcvdPk:count", numPacketsReceived);
+        recordScalar("aggregated:enqueuePk:count", numPacketsEnqueued);
+        recordScalar("aggregated:dropPk:count", numPacketsDropped);
+        recordScalar("aggregated:queueLength:max", maxQueueLength);
+        recordScalar("aggregated:queueLength:timeavg",
+                duration > SIMTIME_ZERO ?
+                        queueLengthIntegral / duration.dbl() : queue.getLength());
+        if (queueingTimeHistogram.getCount() > 0) {
+            recordScalar("aggregated:queueingTime:min", queueingTimeHistogram.getMin(),
+                    "s");
+            recordScalar("aggregated:queueingTime:max", queueingTimeHistogram.getMax(),
+                    "s");
+            recordScalar("aggregated:queueingTime:mean", queueingTimeHistogram.getMean(),
+                    "s");
+            recordScalar("aggregated:queueingTime:p50", queueingTimeQuantile(0.5), "s");
+            recordScalar("aggregated:queueingTime:p90", queueingTimeQuantile(0.9), "s");
+            recordScalar("aggregated:queueingTime:p99", queueingTimeQuantile(0.99), "s");
+        }
+        queueingTimeHistogram.record();
+    }
+}
+
+void LengthAwareQueue::queueLengthChanged() {
+    if (aggregateStatistics) {
+        integrateQueueLength();
+        maxQueueLength = std::max(maxQueueLength, queue.getLength());
+    } else {
+        emit(queueLengthSignal, queue.getLength());
+    }
+}
+
+void LengthAwareQueue::recordQueueingTime(simtime_t queueingTime) {
+    if (aggregateStatistics) {
+        queueingTimeHistogram.collect(queueingTime);
+        sampledQueueingTimeSum += queueingTime;
+        sampledQueueingTimeCount++;
+    } else {
+        emit(queueingTimeSignal, queueingTime);
+    }
+}
+
+void LengthAwareQueue::integrateQueueLength() {
+    simtime_t now = simTime();
+    queueLengthIntegral += queue.getLength()
+            * (now - lastQueueLengthChange).dbl();
+    lastQueueLengthChange = now;
+}
+
+void LengthAwareQueue::handleStatisticsSampleEvent() {
+    integrateQueueLength();
+    simtime_t interval = simTime() - lastStatisticsSample;
+    if (interval > SIMTIME_ZERO) {
+        emit(sampledQueueLengthSignal,
+                (queueLengthIntegral - sampledQueueLengthIntegral)
+                        / interval.dbl());
+    }
+    if (sampledQueueingTimeCount > 0) {
+        emit(sampledQueueingTimeSignal,
+                sampledQueueingTimeSum / sampledQueueingTimeCount);
+    }
+    sampledQueueLengthIntegral = queueLengthIntegral;
+    lastStatisticsSample = simTime();
+    sampledQueueingTimeSum = SIMTIME_ZERO;
+    sampledQueueingTimeCount = 0;
+    scheduleAt(simTime() + statisticsSamplingInterval, &statisticsSampleMsg);
+}
+
+double LengthAwareQueue::queueingTimeQuantile(double quantile) const {
+    const cHistogram& histogram = queueingTimeHistogram;
+    double rank = quantile * histogram.getSumWeights();
+    double weight = histogram.getUnderflowSumWeights();
+    if (rank <= weight || histogram.getNumBins() == 0) {
+        return histogram.getMin();
     }
+    for (int i = 0; i < histogram.getNumBins(); i++) {
+        double binWeight = histogram.getBinValue(i);
+        if (binWeight > 0 && rank <= weight + binWeight) {
+            double lower = histogram.getBinEdge(i);
+            double upper = histogram.getBinEdge(i + 1);
+            return lower + (upper - lower) * (rank - weight) / binWeight;
+        }
+        weight += binWeight;
+    }
+    return histogram.getMax();
+}
+
+uint64_t LengthAwareQueue::requestBits(cPacket* packet) {
+    return packet->getBitLength() + kFrameHeaderBits;
+}
+
+bool LengthAwareQueue::isEmpty(uint64_t maxBits) {
+    return selectPacket(maxBits) == nullptr;
+}
 
-    cPacket* nextPacket = static_cast<cPacket*>(queue.front());
-    return static_cast<uint64_t>(nextPacket->getBitLength() + 240) > maxBits; // add 240 bits to account for headers (30 bytes * 8)
+void LengthAwareQueue::refreshDisplay() const {
+    char buf[80];
+    sprintf(buf, "%s: %d", queue.getName(), queue.getLength());
+    getDisplayString().setTagArg("t", 0, buf);
+}
+
+int LengthAwareQueue::getLength() {
+    return queue.getLength();
 }
 
 void LengthAwareQueue::requestPacket(uint64_t maxBits) {
     Enter_Method("requestPacket(maxBits)");
     maxTransmittableBits = maxBits;
+    requestedPacket = nullptr;
     cancelEvent(&requestPacketMsg);
     scheduleAt(simTime(), &requestPacketMsg);
 }
+
+void LengthAwareQueue::requestPacket(uint64_t maxBits, cPacket* packet) {
+    Enter_Method("requestPacket(maxBits, packet)");
+    ASSERT(queue.contains(packet) && requestBits(packet) <= maxBits);
+    requestPacket(maxBits);
+    requestedPacket = packet;
+}
+
+cPacket* LengthAwareQueue::pop(uint64_t maxBits) {
+    Enter_Method("pop(maxBits)");
+    return takePacket(maxBits, nullptr);
+}
+
+cPacket* LengthAwareQueue::pop(uint64_t maxBits, cPacket* packet) {
+    Enter_Method("pop(maxBits, packet)");
+    ASSERT(queue.contains(packet) && requestBits(packet) <= maxBits);
+    return takePacket(maxBits, packet);
+}
+
 bool LengthAwareQueue::isExpressQueue() {
     return expressQueue;
 }
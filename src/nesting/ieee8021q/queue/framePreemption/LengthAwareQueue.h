@@ -18,12 +18,16 @@
 
 #include <omnetpp.h>
 #include <list>
+#include <algorithm>
 
 #include "inet/common/ModuleAccess.h"
 
 #include "../../Ieee8021q.h"
 #include "../transmissionSelectionAlgorithms/TSAlgorithm.h"
 #include "IPreemptableQueue.h"
+#include "FrameSizeIndex.h"
+#include "FrameRingBuffer.h"
+#include "../SharedBufferManager.h"
 
 using namespace omnetpp;
 using namespace inet;
@@ -47,6 +51,15 @@ protected:
      */
     long availableBufferCapacity;
 
+    /**
+     * Reference to the shared buffer of the switch, or nullptr if the queue
+     * uses its private buffer capacity.
+     */
+    SharedBufferManager* sharedBuffer = nullptr;
+
+    /** Identifier of this queue at the shared buffer. */
+    int sharedBufferQueueId = -1;
+
     /**
      * True if frame preemption is enabled, false otherwise.
      */
@@ -62,10 +75,28 @@ protected:
 
     uint64_t maxTransmittableBits = 0;
 
+    /**
+     * True if a packet request is served with the oldest packet that fits
+     * into the requested number of bits instead of the head of the queue.
+     */
+    bool bestFitSelection;
+
+    /**
+     * Number of packets that were dequeued ahead of an older packet because
+     * of best-fit selection.
+     */
+    long numPacketsBestFit = 0;
+
+    /**
+     * Size index over the queued packets. Only allocated if best-fit
+     * selection is enabled.
+     */
+    FrameSizeIndex* sizeIndex = nullptr;
+
     /**
      * Internal queue datastructure.
      */
-    cQueue queue;
+    FrameRingBuffer queue;
 
     /**
      * Output gate reference.
@@ -74,33 +105,157 @@ protected:
 
     cMessage requestPacketMsg = cMessage("requestPacket");
 
+    /**
+     * Packet chosen by the transmission selection algorithm for the pending
+     * packet request, or nullptr if the queue selects the packet itself.
+     */
+    cPacket* requestedPacket = nullptr;
+
+    /**
+     * True if statistics are aggregated inside the module instead of being
+     * emitted as signals for every packet.
+     */
+    bool aggregateStatistics;
+
+    /**
+     * Interval for emitting aggregated statistics. Zero if they are only
+     * recorded at the end of the simulation.
+     */
+    simtime_t statisticsSamplingInterval;
+
+    cMessage statisticsSampleMsg = cMessage("statisticsSample");
+
+    /** Streaming histogram of the queueing times of all dequeued packets. */
+    cHistogram queueingTimeHistogram;
+
+    /** Time of the last queue length change. */
+    simtime_t lastQueueLengthChange;
+
+    /** Integral of the queue length over time since the simulation start. */
+    double queueLengthIntegral = 0;
+
+    /** Value of queueLengthIntegral at the last statistics sample. */
+    double sampledQueueLengthIntegral = 0;
+
+    /** Time of the last statistics sample. */
+    simtime_t lastStatisticsSample;
+
+    /** Sum and count of the queueing times since the last sample. */
+    simtime_t sampledQueueingTimeSum;
+    long sampledQueueingTimeCount = 0;
+
+    int maxQueueLength = 0;
+
     simsignal_t rcvdPkSignal;
     simsignal_t enqueuePkSignal;
     simsignal_t dequeuePkSignal;
     simsignal_t dropPkByQueueSignal;
     simsignal_t queueingTimeSignal;
     simsignal_t queueLengthSignal;
+    simsignal_t bestFitPkSignal;
+    simsignal_t sampledQueueLengthSignal;
+    simsignal_t sampledQueueingTimeSignal;
 
 protected:
-    virtual void initialize() override;
+    virtual void initialize(int stage) override;
+
+    /** @see cSimpleModule::numInitStages() */
+    virtual int numInitStages() const override;
 
     virtual void handleMessage(cMessage* msg) override;
 
     virtual void enqueue(cPacket* packet);
 
-    virtual cPacket* dequeue();
+    virtual cPacket* dequeue(cPacket* packet);
+
+    /**
+     * Takes buffer for a packet from the private or shared buffer.
+     *
+     * @return False if there is not enough buffer left for the packet.
+     */
+    virtual bool allocateBuffer(cPacket* packet);
+
+    /** Returns the buffer of a dequeued packet. */
+    virtual void releaseBuffer(cPacket* packet);
+
+    /**
+     * Returns the packet to send for a request of maxBits, or nullptr if no
+     * packet fits. This is the head of the queue, or the oldest fitting
+     * packet if best-fit selection is enabled.
+     */
+    virtual cPacket* selectPacket(uint64_t maxBits);
+
+    /**
+     * Dequeues the given packet, or the packet selected for maxBits if
+     * packet is nullptr, and records its statistics.
+     */
+    virtual cPacket* takePacket(uint64_t maxBits, cPacket* packet);
 
     virtual void handleRequestPacketEvent(uint64_t maxBits);
 
     virtual void handlePacketEnqueuedEvent(cPacket* packet);
 
+    virtual void finish() override;
+
+    /**
+     * @see cSimpleModule::refreshDisplay() const
+     */
+    virtual void refreshDisplay() const override;
+
+    /**
+     * Reports a changed queue length, either as queueLength signal or to the
+     * aggregated statistics.
+     */
+    virtual void queueLengthChanged();
+
+    /** Reports the queueing time of a dequeued packet. */
+    virtual void recordQueueingTime(simtime_t queueingTime);
+
+    /** Adds the queue length since the last change to the time integral. */
+    virtual void integrateQueueLength();
+
+    /** Emits the aggregated statistics of the last sampling interval. */
+    virtual void handleStatisticsSampleEvent();
+
+    /**
+     * Returns the given quantile of the queueing times, interpolated within
+     * the bins of the queueing time histogram.
+     */
+    virtual double queueingTimeQuantile(double quantile) const;
+
 public:
     virtual ~LengthAwareQueue();
 
+    /**
+     * Returns the number of bits a packet needs in a packet request, i.e. the
+     * smallest maxBits of isEmpty(uint64_t) and requestPacket(uint64_t) the
+     * packet fits into.
+     */
+    static uint64_t requestBits(cPacket* packet);
+
     virtual bool isEmpty(uint64_t maxBits);
 
+    /** Returns the number of packets in the queue. */
+    virtual int getLength();
+
     virtual void requestPacket(uint64_t maxBits);
 
+    /**
+     * Requests a specific queued packet, e.g. the packet a transmission
+     * selection algorithm orders first, instead of the packet the queue
+     * would select itself. The packet has to fit into maxBits.
+     */
+    virtual void requestPacket(uint64_t maxBits, cPacket* packet);
+
+    /**
+     * Removes and returns the packet that requestPacket(maxBits) would send,
+     * without any intermediate event. The caller has to take ownership.
+     */
+    virtual cPacket* pop(uint64_t maxBits);
+
+    /** Removes and returns a specific queued packet, see pop(uint64_t). */
+    virtual cPacket* pop(uint64_t maxBits, cPacket* packet);
+
     virtual bool isExpressQueue();
 };
 
@@ -0,0 +1,180 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "CyclicQueuingController.h"
+
+namespace nesting {
+
+Define_Module(CyclicQueuingController);
+
+void CyclicQueuingController::initialize(int stage) {
+    if (stage == INITSTAGE_LOCAL) {
+        clock = getModuleFromPar<IClock>(par("clockModule"), this);
+
+        TransmissionGate* transmissionGateVectorModule = getModuleFromPar<
+                TransmissionGate>(par("transmissionGateVectorModule"), this);
+        int numberOfQueues = transmissionGateVectorModule->getVectorSize();
+        if (numberOfQueues > static_cast<int>(sizeof(unsigned int) * 8)) {
+            throw cRuntimeError("CQF supports at most %d queues.",
+                    static_cast<int>(sizeof(unsigned int) * 8));
+        }
+        transmissionGates.resize(numberOfQueues);
+        pairedQueue.resize(numberOfQueues, kNoQueue);
+        cModule::SubmoduleIterator it = cModule::SubmoduleIterator(
+                transmissionGateVectorModule->getParentModule());
+        for (; !it.end(); it++) {
+            cModule* subModule = *it;
+            if (subModule->isName(transmissionGateVectorModule->getName())) {
+                TransmissionGate* transmissionGate = check_and_cast<
+                        TransmissionGate*>(subModule);
+                transmissionGates[transmissionGate->getIndex()] =
+                        transmissionGate;
+            }
+        }
+
+        // The first queue of every pair receives in the first cycle
+        std::vector<int> queues = cStringTokenizer(
+                par("queuePairs").stringValue()).asIntVector();
+        if (queues.size() % 2 != 0) {
+            throw cRuntimeError("queuePairs must list an even number of queues.");
+        }
+        for (size_t i = 0; i < queues.size(); i += 2) {
+            int first = queues[i];
+            int second = queues[i + 1];
+            if (first < 0 || first >= numberOfQueues || second < 0
+                    || second >= numberOfQueues || first == second
+                    || (cqfMask & ((1u << first) | (1u << second)))) {
+                throw cRuntimeError("Invalid CQF queue pair %d %d.", first,
+                        second);
+            }
+            pairedQueue[first] = second;
+            pairedQueue[second] = first;
+            cqfMask |= (1u << first) | (1u << second);
+            receivingMask |= 1u << first;
+        }
+
+        cycleTime = par("cycleTime");
+        cycleViolationsSignal = registerSignal("cycleViolations");
+
+        WATCH(cqfMask);
+        WATCH(receivingMask);
+        WATCH(numCycles);
+        WATCH(numCycleViolations);
+    } else if (stage == INITSTAGE_LINK_LAYER) {
+        // The clock is initialized in the first stage
+        simtime_t clockRate = clock->getClockRate();
+        int64_t ticks = cycleTime.raw() / clockRate.raw();
+        if (ticks <= 0 || ticks * clockRate.raw() != cycleTime.raw()) {
+            throw cRuntimeError(
+                    "cycleTime must be a positive multiple of the clock rate.");
+        }
+        cycleTicks = static_cast<unsigned int>(ticks);
+
+        // The gates of the CQF queues are not part of the gate control list
+        gateController = getModuleFromPar<GateController>(
+                par("gateControllerModule"), this);
+        for (size_t i = 0; i < transmissionGates.size(); i++) {
+            if (cqfMask & (1u << i)) {
+                gateController->excludeGate(transmissionGates[i]);
+                transmissionGates[i]->setCyclicQueuingController(this);
+            }
+        }
+
+        applyGateStates();
+        if (cqfMask != 0) {
+            clock->subscribeTick(this, cycleTicks);
+        }
+    }
+}
+
+int CyclicQueuingController::numInitStages() const {
+    return INITSTAGE_LINK_LAYER + 1;
+}
+
+void CyclicQueuingController::handleMessage(cMessage* msg) {
+    throw cRuntimeError("cannot handle messages");
+}
+
+void CyclicQueuingController::tick(IClock *clock) {
+    Enter_Method("tick()");
+
+    // Frames still waiting in a transmitting queue were received more than
+    // one cycle ago and miss their cycle
+    long violations = 0;
+    unsigned int transmitting = cqfMask & ~receivingMask;
+    while (transmitting != 0) {
+        int queueIndex = __builtin_ctz(transmitting);
+        transmitting &= transmitting - 1;
+        violations += transmissionGates[queueIndex]->getTSAlgorithm()
+                ->getQueue()->getLength();
+    }
+    if (violations > 0) {
+        EV_WARN << getFullPath() << ": " << violations
+                       << " frames missed their cycle." << endl;
+        numCycleViolations += violations;
+        emit(cycleViolationsSignal, violations);
+    }
+
+    receivingMask ^= cqfMask;
+    numCycles++;
+    applyGateStates();
+
+    clock->subscribeTick(this, cycleTicks);
+}
+
+unsigned int CyclicQueuingController::calculateMaxBit(int queueIndex) {
+    ASSERT(cqfMask & (1u << queueIndex));
+    double transmitRate = gateController->getTransmitRate();
+    if (transmitRate <= 0 || (receivingMask & (1u << queueIndex))) {
+        return 0;
+    }
+    simtime_t timeUntilSwap = cycleTime - (clock->getTime() - lastSwap);
+    if (timeUntilSwap <= SIMTIME_ZERO) {
+        return 0;
+    }
+    // Like the gate control list lookahead, no more than one MTU is needed
+    double bits = timeUntilSwap.dbl() * transmitRate;
+    if (bits >= kEthernet2MaximumTransmissionUnitBitLength.get()) {
+        return kEthernet2MaximumTransmissionUnitBitLength.get();
+    }
+    return static_cast<unsigned int>(bits);
+}
+
+void CyclicQueuingController::applyGateStates() {
+    lastSwap = clock->getTime();
+    unsigned int queues = cqfMask;
+    while (queues != 0) {
+        int queueIndex = __builtin_ctz(queues);
+        queues &= queues - 1;
+        transmissionGates[queueIndex]->setGateState(
+                !(receivingMask & (1u << queueIndex)), false);
+    }
+}
+
+void CyclicQueuingController::finish() {
+    recordScalar("cycles", numCycles);
+    recordScalar("cycleViolations", numCycleViolations);
+    recordScalar("cycleTime", cycleTime, "s");
+    // A frame is received within one cycle and sent in the next one
+    recordScalar("hopLatencyBound", 2 * cycleTime, "s");
+}
+
+void CyclicQueuingController::refreshDisplay() const {
+    char buf[80];
+    sprintf(buf, "violations: %ld", numCycleViolations);
+    getDisplayString().setTagArg("t", 0, buf);
+}
+
+} // namespace nesting
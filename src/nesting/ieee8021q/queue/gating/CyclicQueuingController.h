@@ -0,0 +1,128 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __MAIN_CYCLICQUEUINGCONTROLLER_H_
+#define __MAIN_CYCLICQUEUINGCONTROLLER_H_
+
+#include <omnetpp.h>
+#include <vector>
+
+#include "inet/common/ModuleAccess.h"
+#include "inet/common/InitStages.h"
+
+#include "../../clock/IClock.h"
+#include "../../clock/IClockListener.h"
+#include "GateController.h"
+#include "TransmissionGate.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * See the NED file for a detailed description.
+ */
+class CyclicQueuingController: public cSimpleModule, public IClockListener {
+protected:
+    static const int kNoQueue = -1;
+
+    IClock* clock;
+
+    /** Gate controller of the port, which provides the transmit rate. */
+    GateController* gateController;
+
+    /** Transmission gates of all queues of the port, indexed by queue. */
+    std::vector<TransmissionGate*> transmissionGates;
+
+    /** Partner queue of every CQF queue, kNoQueue for other queues. */
+    std::vector<int> pairedQueue;
+
+    /** Bitmask of the queues belonging to a CQF pair. */
+    unsigned int cqfMask = 0;
+
+    /**
+     * Bitmask of the CQF queues that currently receive frames. Exactly one
+     * queue of every pair is set, the other one transmits.
+     */
+    unsigned int receivingMask = 0;
+
+    /** Cycle length in clock ticks. */
+    unsigned int cycleTicks;
+
+    /** Cycle length in simulation time. */
+    simtime_t cycleTime;
+
+    /** Time of the last swap of the queue roles. */
+    simtime_t lastSwap;
+
+    long numCycles = 0;
+
+    /**
+     * Number of frames left in a transmitting queue at the end of its cycle,
+     * which are therefore sent later than the cycle after their reception.
+     */
+    long numCycleViolations = 0;
+
+    simsignal_t cycleViolationsSignal;
+
+protected:
+    /** @see cSimpleModule::initialize(int) */
+    virtual void initialize(int stage) override;
+
+    /** @see cSimpleModule::numInitStages() */
+    virtual int numInitStages() const override;
+
+    /** @see cSimpleModule::handleMessage(cMessage*) */
+    virtual void handleMessage(cMessage* msg) override;
+
+    /** @see cSimpleModule::finish() */
+    virtual void finish() override;
+
+    /** @see cSimpleModule::refreshDisplay() const */
+    virtual void refreshDisplay() const override;
+
+    /**
+     * Opens the gates of the transmitting queues and closes the gates of the
+     * receiving queues.
+     */
+    virtual void applyGateStates();
+
+public:
+    /** Swaps the roles of the queues of every pair. */
+    virtual void tick(IClock *clock) override;
+
+    /**
+     * Calculates the maximum number of bits the gate of a CQF queue can
+     * transmit until the next swap of the queue roles, which closes it.
+     * Returns zero for a receiving queue, whose gate is closed.
+     */
+    virtual unsigned int calculateMaxBit(int queueIndex);
+
+    /**
+     * Returns the queue a frame classified into the given queue is stored in.
+     * For a CQF queue this is the queue of its pair that currently receives.
+     */
+    int receivingQueue(int queueIndex) const {
+        if (!(cqfMask & (1u << queueIndex))
+                || (receivingMask & (1u << queueIndex))) {
+            return queueIndex;
+        }
+        return pairedQueue[queueIndex];
+    }
+};
+
+} // namespace nesting
+
+#endif
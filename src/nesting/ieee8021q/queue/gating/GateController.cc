@@ -14,6 +14,8 @@
 // 
 
 #include "../../queue/gating/GateController.h"
+
+#include <limits>
 #define COMPILETIME_LOGLEVEL omnetpp::LOGLEVEL_TRACE
 
 namespace nesting {
@@ -192,13 +194,15 @@ void GateController::tick(IClock *clock) {
     scheduleIndex = (scheduleIndex + 1) % currentSchedule->size();
 }
 
-unsigned int GateController::calculateMaxBit(int gateIndex) {
-    double transmitRate;
+double GateController::getTransmitRate() {
     if (preemptMacModule != nullptr) {
-        transmitRate = preemptMacModule->getTxRate();
-    } else {
-        transmitRate = macModule->getTxRate();
+        return preemptMacModule->getTxRate();
     }
+    return macModule->getTxRate();
+}
+
+unsigned int GateController::calculateMaxBit(int gateIndex) {
+    double transmitRate = getTransmitRate();
     if (transmitRate <= 0) {
         return 0;
     }
@@ -263,6 +267,30 @@ unsigned int GateController::calculateMaxBit(int gateIndex) {
 
 }
 
+uint64_t GateController::calculateStableBits(int gateIndex) {
+    bool controlled = std::any_of(transmissionGates.begin(),
+            transmissionGates.end(), [gateIndex](TransmissionGate* gate) {
+                return gate->getIndex() == gateIndex;
+            });
+    double transmitRate = getTransmitRate();
+    if (!controlled || transmitRate <= 0) {
+        return 0;
+    }
+    // Without schedule entries all gates are open and tick() is not called
+    // again, so they stay open for good
+    if (currentSchedule->isEmpty()) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    unsigned int currentIndex = (scheduleIndex + currentSchedule->size() - 1)
+            % currentSchedule->size();
+    simtime_t remaining = currentSchedule->getLength(currentIndex)
+            * clock->getClockRate() - (clock->getTime() - lastChange);
+    if (remaining <= SIMTIME_ZERO) {
+        return 0;
+    }
+    return static_cast<uint64_t>(remaining.dbl() * transmitRate);
+}
+
 void GateController::loadScheduleOrDefault(cXMLElement* xml) {
     Schedule<GateBitvector> *schedule;
     bool realScheduleFound = false;
@@ -315,6 +343,12 @@ void GateController::openAllGates() {
     bitvectorAllGatesOpen.set();
     setGateStates(bitvectorAllGatesOpen, true);
 }
+void GateController::excludeGate(TransmissionGate* transmissionGate) {
+    transmissionGates.erase(
+            std::remove(transmissionGates.begin(), transmissionGates.end(),
+                    transmissionGate), transmissionGates.end());
+}
+
 bool GateController::currentlyOnHold() {
     if (preemptMacModule != nullptr) {
         return preemptMacModule->isOnHold();
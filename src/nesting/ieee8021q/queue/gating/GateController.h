@@ -17,6 +17,7 @@
 #define __MAIN_GATECONTROLLER_H_
 
 #include <omnetpp/simtime_t.h>
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -90,6 +91,9 @@ protected:
 public:
     virtual ~GateController();
 
+    /** Returns the transmit rate of the Mac module in bit per second. */
+    virtual double getTransmitRate();
+
     /** @see IClockListener::tick(IClock*) */
     virtual void tick(IClock *clock) override;
 
@@ -98,11 +102,25 @@ public:
      **/
     virtual unsigned int calculateMaxBit(int gateIndex);
 
+    /**
+     * Calculates the number of bits that can be transmitted until the current
+     * schedule entry ends, i.e. until any gate may change its state next.
+     * Returns zero for gates that are not controlled by this module, and the
+     * maximum value if the schedule is empty and all gates stay open.
+     */
+    virtual uint64_t calculateStableBits(int gateIndex);
+
     /** extracts and loads the correct schedule from xml file, or an empty one if none is defined */
     virtual void loadScheduleOrDefault(cXMLElement* xml);
 
     virtual bool currentlyOnHold();
 
+    /**
+     * Stops controlling the state of a transmission gate, e.g. because it is
+     * controlled by a ~CyclicQueuingController.
+     */
+    virtual void excludeGate(TransmissionGate* transmissionGate);
+
 };
 
 } // namespace nesting
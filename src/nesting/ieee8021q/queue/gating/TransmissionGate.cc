@@ -14,6 +14,7 @@
 // 
 
 #include "../../queue/gating/TransmissionGate.h"
+#include "CyclicQueuingController.h"
 #define COMPILETIME_LOGLEVEL omnetpp::LOGLEVEL_TRACE
 
 #define COMPILETIME_LOGLEVEL omnetpp::LOGLEVEL_TRACE
@@ -117,7 +118,12 @@ void TransmissionGate::handleGateStateChangedEvent() {
 
 uint64_t TransmissionGate::maxTransferableBits() {
     if (lengthAwareSchedulingEnabled) {
-        unsigned int maxbit = gateController->calculateMaxBit(getIndex());
+        // Gates controlled by the CQF controller are not part of the gate
+        // control list and close at the next cycle swap
+        unsigned int maxbit =
+                cqfController != nullptr ?
+                        cqfController->calculateMaxBit(getIndex()) :
+                        gateController->calculateMaxBit(getIndex());
         EV_DEBUG << getFullPath() << ": max bit transferable: " << maxbit
                         << " at time " << clock->getTime().inUnit(SIMTIME_US)
                         << endl;
@@ -127,6 +133,11 @@ uint64_t TransmissionGate::maxTransferableBits() {
     return kEthernet2MaximumTransmissionUnitBitLength.get();
 }
 
+void TransmissionGate::setCyclicQueuingController(
+        CyclicQueuingController* cqfController) {
+    this->cqfController = cqfController;
+}
+
 bool TransmissionGate::isGateOpen() {
     return gateOpen;
 }
@@ -140,6 +151,7 @@ void TransmissionGate::setGateState(bool gateOpen, bool release) {
 
     // Schedule gate-state-changed event
     if (gateStateChanged) {
+        updateSelectionState();
         cancelEvent(&gateStateChangedMsg);
         scheduleAt(simTime(), &gateStateChangedMsg);
     } else if(release && gateOpen && !tsAlgorithm->isEmpty(maxTransferableBits()) && (isExpressQueue() || !gateController->currentlyOnHold())) {
@@ -148,11 +160,14 @@ void TransmissionGate::setGateState(bool gateOpen, bool release) {
 }
 
 bool TransmissionGate::isEmpty() {
-    return !isGateOpen()
-            || (!isExpressQueue() && gateController->currentlyOnHold())
+    return isBlocked(isExpressQueue())
             || tsAlgorithm->isEmpty(maxTransferableBits());
 }
 
+bool TransmissionGate::isBlocked(bool express) {
+    return !gateOpen || (!express && gateController->currentlyOnHold());
+}
+
 void TransmissionGate::requestPacket() {
     Enter_Method("requestPacket()");
 
@@ -160,6 +175,16 @@ void TransmissionGate::requestPacket() {
     scheduleAt(simTime(), &requestPacketMsg);
 }
 
+cPacket* TransmissionGate::pop() {
+    Enter_Method("pop()");
+    ASSERT(!isEmpty());
+    return tsAlgorithm->pop(maxTransferableBits());
+}
+
+uint64_t TransmissionGate::stableBits() {
+    return gateController->calculateStableBits(getIndex());
+}
+
 void TransmissionGate::packetEnqueued() {
     Enter_Method("packetEnqueued()");
 
@@ -170,5 +195,12 @@ void TransmissionGate::packetEnqueued() {
 bool TransmissionGate::isExpressQueue() {
     return tsAlgorithm->isExpressQueue();
 }
+
+void TransmissionGate::updateSelectionState() {
+    bool nonEmpty = !tsAlgorithm->isQueueEmpty();
+    bool eligible = nonEmpty && gateOpen && tsAlgorithm->isEligible();
+    transmissionSelection->updateQueueState(getIndex(), isExpressQueue(),
+            nonEmpty, eligible);
+}
 }
 //namespace nesting
@@ -36,6 +36,7 @@ namespace nesting {
 class GateController;
 class TransmissionSelection;
 class TSAlgorithm;
+class CyclicQueuingController;
 
 /**
  * See the NED file for a detailed description
@@ -47,6 +48,12 @@ private:
      */
     GateController* gateController;
 
+    /**
+     * Reference to the CQF controller if it controls the state of this gate
+     * instead of the gate-controller, nullptr otherwise.
+     */
+    CyclicQueuingController* cqfController = nullptr;
+
     /**
      * Reference to the transmission-selection module. Packet-enqueued events
      * are signaled to this module whenever a packet becomes ready for
@@ -135,8 +142,9 @@ protected:
 
     /**
      * Calculates the maximum amount of transferable bits until the gate
-     * closes. If length-aware-scheduling is disabled, ethernet2 MTU size is
-     * returned.
+     * closes, i.e. until the next entry of the gate control list or, for a
+     * gate controlled by a CQF controller, until the next cycle swap. If
+     * length-aware-scheduling is disabled, ethernet2 MTU size is returned.
      */
     virtual uint64_t maxTransferableBits();
 
@@ -153,6 +161,14 @@ public:
      */
     virtual void setGateState(bool gateOpen, bool release);
 
+    /**
+     * Hands the control of the gate state over to a CQF controller, which is
+     * then also asked for the number of bits transferable until the gate
+     * closes.
+     */
+    virtual void setCyclicQueuingController(
+            CyclicQueuingController* cqfController);
+
     /**
      * Tells if the gate is empty from a queuing perspective.
      */
@@ -164,6 +180,18 @@ public:
      */
     virtual void requestPacket();
 
+    /**
+     * Removes and returns the packet that requestPacket() would deliver,
+     * without any intermediate event. The caller has to take ownership.
+     */
+    virtual cPacket* pop();
+
+    /**
+     * Returns the number of bits that can be transmitted before any gate may
+     * change its state, or zero if that is not known for this gate.
+     */
+    virtual uint64_t stableBits();
+
     /**
      * Notifies the transmission-gate, that a packet got ready for transmission
      * on the input module.
@@ -172,6 +200,24 @@ public:
 
     virtual bool isExpressQueue();
 
+    /**
+     * Reports the current queue state behind this gate (non-empty and
+     * eligible for transmission) to the transmission-selection module. Must
+     * be called whenever the gate state, the queue length or the
+     * transmission-selection-algorithm state changes.
+     */
+    virtual void updateSelectionState();
+
+    /**
+     * Returns true if the gate is closed or, for a preemptable queue, the Mac
+     * module is on hold. Unlike isEmpty(), the input queue is not checked.
+     */
+    bool isBlocked(bool express);
+
+    TSAlgorithm* getTSAlgorithm() const {
+        return tsAlgorithm;
+    }
+
 };
 
 } // namespace nesting
@@ -0,0 +1,177 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "AnalyticCreditBasedShaper.h"
+
+namespace nesting {
+
+Define_Module(AnalyticCreditBasedShaper);
+
+void AnalyticCreditBasedShaper::advance() {
+    if (state != kSpendCredit || simTime() < spendingEnd) {
+        return;
+    }
+
+    EV_TRACE << getFullPath() << ": Evaluate end of spending credit at "
+                    << spendingEnd << "." << endl;
+
+    bool reset = !packetReady && CreditBasedShaper::isCreditPositive();
+    if (!reset && packetReady && gateOpen) {
+        state = kEarnCredit;
+    } else {
+        state = kIdle;
+    }
+    lastEventTimestamp = spendingEnd;
+
+    // Not resetCredit(), as its selection state update queries the credit
+    // and thereby advance(). The credit stays non-negative, so the selection
+    // state is unchanged.
+    if (reset) {
+        credit = 0;
+        emitCredit(spendingEnd);
+    }
+}
+
+void AnalyticCreditBasedShaper::rescheduleZeroCredit() {
+    cancelEvent(&reachedZeroCreditMessage);
+    if (!packetReady || !gateOpen) {
+        return;
+    }
+
+    simtime_t zeroCreditTime;
+    if (state == kEarnCredit && !CreditBasedShaper::isCreditPositive()) {
+        zeroCreditTime = lastEventTimestamp
+                + timeForCredits(getIdleSlope(), 0 - credit);
+    } else if (state == kSpendCredit && credit < 0) {
+        // Earning starts at the end of the spending period
+        zeroCreditTime = spendingEnd
+                + timeForCredits(getIdleSlope(), 0 - credit);
+    } else {
+        return;
+    }
+    scheduleAt(zeroCreditTime, &reachedZeroCreditMessage);
+}
+
+double AnalyticCreditBasedShaper::currentCredit() {
+    advance();
+    if (state == kEarnCredit) {
+        return credit
+                + creditsForTime(getIdleSlope(),
+                        simTime() - lastEventTimestamp);
+    }
+    return credit;
+}
+
+double AnalyticCreditBasedShaper::getPortTransmitRate() {
+    if (portTransmitRate <= 0) {
+        portTransmitRate = mac->getTxRate();
+    }
+    return portTransmitRate;
+}
+
+bool AnalyticCreditBasedShaper::isCreditPositive() {
+    return static_cast<int>(currentCredit()) >= 0;
+}
+
+void AnalyticCreditBasedShaper::earnCredits(simtime_t time) {
+    // The credit earned so far becomes part of the stored credit, so that the
+    // selection state update does not add it a second time.
+    lastEventTimestamp = simTime();
+    CreditBasedShaper::earnCredits(time);
+}
+
+void AnalyticCreditBasedShaper::handleGateStateChangedEvent() {
+    advance();
+    if (transmissionGate->isGateOpen()) {
+        EV_TRACE << getFullPath() << ": Handle gate opened event." << endl;
+        if (state == kIdle && isPacketReadyForTransmission()) {
+            updateState(kEarnCredit);
+        }
+    } else {
+        EV_TRACE << getFullPath() << ": Handle gate closed event." << endl;
+        if (state == kEarnCredit) {
+            earnCredits(simTime() - lastEventTimestamp);
+            updateState(kIdle);
+        }
+    }
+    rescheduleZeroCredit();
+}
+
+void AnalyticCreditBasedShaper::handlePacketEnqueuedEvent() {
+    EV_TRACE << getFullPath() << ": Handle packet enqueued event." << endl;
+
+    advance();
+    if (state == kIdle && transmissionGate->isGateOpen()) {
+        updateState(kEarnCredit);
+    } else if (state == kEarnCredit) {
+        earnCredits(simTime() - lastEventTimestamp);
+        updateState(kEarnCredit);
+    }
+    rescheduleZeroCredit();
+
+    if (isCreditPositive()) {
+        transmissionGate->packetEnqueued();
+    }
+}
+
+void AnalyticCreditBasedShaper::handleSendPacketEvent(Packet* packet) {
+    EV_TRACE << getFullPath() << ": Handle send packet event." << endl;
+
+    advance();
+    assert(state != kSpendCredit);
+    assert(isCreditPositive());
+
+    // The rate is only refreshed once per packet
+    portTransmitRate = mac->getTxRate();
+
+    if (state == kEarnCredit) {
+        earnCredits(simTime() - lastEventTimestamp);
+    }
+    spendCredit(packet);
+    spendingEnd = simTime() + transmissionTime(packet);
+    updateState(kSpendCredit);
+    rescheduleZeroCredit();
+}
+
+void AnalyticCreditBasedShaper::handleZeroCreditReachedEvent() {
+    advance();
+    CreditBasedShaper::handleZeroCreditReachedEvent();
+}
+
+void AnalyticCreditBasedShaper::gateStateChanged() {
+    Enter_Method("gateStateChanged()");
+    advance();
+    gateOpen = transmissionGate->isGateOpen();
+    // Credit is evaluated lazily, so the change is handled right away
+    // instead of in a gateStateChanged self message.
+    handleGateStateChangedEvent();
+}
+
+void AnalyticCreditBasedShaper::packetEnqueued() {
+    Enter_Method("packetEnqueued()");
+    handlePacketEnqueuedEvent();
+}
+
+void AnalyticCreditBasedShaper::queueStateChanged() {
+    advance();
+    packetReady = isPacketReadyForTransmission();
+    CreditBasedShaper::queueStateChanged();
+}
+
+bool AnalyticCreditBasedShaper::isEligible() {
+    return isCreditPositive();
+}
+
+} // namespace nesting
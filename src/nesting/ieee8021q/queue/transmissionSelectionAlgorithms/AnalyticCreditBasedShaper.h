@@ -0,0 +1,101 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __MAIN_ANALYTICCREDITBASEDSHAPER_H_
+#define __MAIN_ANALYTICCREDITBASEDSHAPER_H_
+
+#include <omnetpp.h>
+
+#include "CreditBasedShaper.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * See the NED file for a detailed description.
+ */
+class AnalyticCreditBasedShaper: public CreditBasedShaper {
+protected:
+    /** End of the current credit spending period. */
+    simtime_t spendingEnd;
+
+    /**
+     * True if the input queue holds a packet. Updated after the end of a
+     * spending period has been evaluated, so that the evaluation sees the
+     * queue state of that time.
+     */
+    bool packetReady = false;
+
+    /** Gate state, cached like packetReady. */
+    bool gateOpen = true;
+
+    /** Cached port transmit rate in bits per second, 0 if unknown. */
+    double portTransmitRate = 0;
+
+protected:
+    /**
+     * Performs the state transition of a spending period that has ended since
+     * the last event, as CreditBasedShaper::handleEndSpendingCreditEvent()
+     * would have done at that time.
+     */
+    virtual void advance();
+
+    /**
+     * Schedules reachedZeroCreditMessage for the time a waiting packet
+     * becomes eligible, or cancels it if no packet is waiting.
+     */
+    virtual void rescheduleZeroCredit();
+
+    /** Returns the current credit including credit earned since the last event. */
+    virtual double currentCredit();
+
+    /** Returns the cached port transmit rate. */
+    virtual double getPortTransmitRate() override;
+
+    /** Returns true if the current credit is greater or equal to zero. */
+    virtual bool isCreditPositive() override;
+
+    /** Adds the credit earned in the given time to the stored credit. */
+    virtual void earnCredits(simtime_t time) override;
+
+    virtual void handleGateStateChangedEvent() override;
+
+    virtual void handlePacketEnqueuedEvent() override;
+
+    virtual void handleSendPacketEvent(Packet* packet) override;
+
+    virtual void handleZeroCreditReachedEvent() override;
+
+public:
+    /** Handles the gate state change without a self message. */
+    virtual void gateStateChanged() override;
+
+    /** Handles the enqueued packet without a self message. */
+    virtual void packetEnqueued() override;
+
+    virtual void queueStateChanged() override;
+
+    /**
+     * Returns true if the current credit is greater or equal to zero. Credit
+     * only turns positive without an event while no packet is waiting, in
+     * which case the queue is not eligible anyway.
+     */
+    virtual bool isEligible() override;
+};
+
+} // namespace nesting
+
+#endif
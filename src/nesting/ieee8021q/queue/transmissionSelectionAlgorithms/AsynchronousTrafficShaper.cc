@@ -0,0 +1,247 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "AsynchronousTrafficShaper.h"
+
+#include <map>
+
+#include "inet/linklayer/common/MacAddressTag_m.h"
+
+#include "../../Ieee8021q.h"
+#include "../../../linklayer/common/VLANTag_m.h"
+
+namespace nesting {
+
+Define_Module(AsynchronousTrafficShaper);
+
+AsynchronousTrafficShaper::~AsynchronousTrafficShaper() {
+    cancelEvent(&eligibilityTimeMsg);
+}
+
+void AsynchronousTrafficShaper::initialize() {
+    TSAlgorithm::initialize();
+
+    maxResidenceTime = par("maxResidenceTime");
+    eligibilityDelaySignal = registerSignal("eligibilityDelay");
+
+    // Streams with the same group attribute share a shaper group, all other
+    // streams get a group of their own.
+    std::map<int, int> groups;
+    cXMLElement* streams = par("streams").xmlValue();
+    for (cXMLElement* stream : streams->getChildrenByTagName("stream")) {
+        const char* rateAttr = stream->getAttribute("committedInformationRate");
+        const char* burstAttr = stream->getAttribute("committedBurstSize");
+        if (rateAttr == nullptr || burstAttr == nullptr) {
+            throw cRuntimeError(
+                    "stream tag at %s must have a committedInformationRate and "
+                            "a committedBurstSize attribute",
+                    stream->getSourceLocation());
+        }
+        int group = -1;
+        if (const char* groupAttr = stream->getAttribute("group")) {
+            auto it = groups.find(atoi(groupAttr));
+            if (it == groups.end()) {
+                it = groups.emplace(atoi(groupAttr),
+                        groupEligibilityTimes.size()).first;
+                groupEligibilityTimes.push_back(SIMTIME_ZERO);
+            }
+            group = it->second;
+        }
+        classifier.addStream(stream, shapers.size());
+        addShaper(atof(rateAttr), atof(burstAttr), group);
+    }
+
+    double committedInformationRate = par("committedInformationRate");
+    shapeOtherFrames = committedInformationRate > 0;
+    if (shapeOtherFrames) {
+        addShaper(committedInformationRate, par("committedBurstSize"), -1);
+    }
+
+    WATCH(numPacketsShaped);
+    WATCH(numPacketsDiscarded);
+}
+
+void AsynchronousTrafficShaper::addShaper(double committedInformationRate,
+        double committedBurstSize, int group) {
+    if (committedInformationRate <= 0 || committedBurstSize <= 0) {
+        throw cRuntimeError(
+                "Committed information rate and burst size of shaper %d must "
+                        "be positive.", static_cast<int>(shapers.size()));
+    }
+    if (group < 0) {
+        group = groupEligibilityTimes.size();
+        groupEligibilityTimes.push_back(SIMTIME_ZERO);
+    }
+
+    Shaper shaper;
+    shaper.committedInformationRate = committedInformationRate;
+    shaper.emptyToFullDuration = committedBurstSize / committedInformationRate;
+    // The token bucket is full at the start of the simulation
+    shaper.bucketEmptyTime = SIMTIME_ZERO - shaper.emptyToFullDuration;
+    shaper.group = group;
+    shapers.push_back(shaper);
+}
+
+void AsynchronousTrafficShaper::handleMessage(cMessage* msg) {
+    if (msg == &eligibilityTimeMsg) {
+        handleEligibilityTimeEvent();
+    } else {
+        TSAlgorithm::handleMessage(msg);
+    }
+}
+
+void AsynchronousTrafficShaper::finish() {
+    recordScalar("packetsShaped", numPacketsShaped);
+    recordScalar("packetsDiscarded", numPacketsDiscarded);
+}
+
+AsynchronousTrafficShaper::Shaper* AsynchronousTrafficShaper::findShaper(
+        Packet* packet) {
+    if (!classifier.isEmpty()) {
+        auto macTag = packet->findTag<inet::MacAddressReq>();
+        auto vlanTag = packet->findTag<VLANTagReq>();
+        int shaper = classifier.classify(
+                macTag ? macTag->getDestAddress() : inet::MacAddress::UNSPECIFIED_ADDRESS,
+                macTag ? macTag->getSrcAddress() : inet::MacAddress::UNSPECIFIED_ADDRESS,
+                vlanTag ? vlanTag->getVID() : 0,
+                vlanTag ? vlanTag->getPcp() : 0);
+        if (shaper >= 0) {
+            return &shapers[shaper];
+        }
+    }
+    return shapeOtherFrames ? &shapers.back() : nullptr;
+}
+
+simtime_t AsynchronousTrafficShaper::eligibilityTime(Shaper& shaper,
+        uint64_t frameBits, simtime_t arrivalTime) {
+    // Token bucket emulation according to IEEE 802.1Qcr. The bucket state is
+    // represented by the time at which it is empty, so that no token refill
+    // events are needed.
+    simtime_t& groupEligibilityTime = groupEligibilityTimes[shaper.group];
+    simtime_t lengthRecoveryDuration = frameBits
+            / shaper.committedInformationRate;
+    simtime_t schedulerEligibilityTime = shaper.bucketEmptyTime
+            + lengthRecoveryDuration;
+    simtime_t bucketFullTime = shaper.bucketEmptyTime
+            + shaper.emptyToFullDuration;
+    simtime_t eligibilityTime = std::max(arrivalTime,
+            std::max(groupEligibilityTime, schedulerEligibilityTime));
+
+    if (maxResidenceTime > SIMTIME_ZERO
+            && eligibilityTime > arrivalTime + maxResidenceTime) {
+        return eligibilityTime;
+    }
+
+    groupEligibilityTime = eligibilityTime;
+    if (eligibilityTime < bucketFullTime) {
+        shaper.bucketEmptyTime = schedulerEligibilityTime;
+    } else {
+        // Tokens exceeding the burst size were not kept
+        shaper.bucketEmptyTime = schedulerEligibilityTime + eligibilityTime
+                - bucketFullTime;
+    }
+    return eligibilityTime;
+}
+
+bool AsynchronousTrafficShaper::admitPacket(cPacket* packet) {
+    Enter_Method("admitPacket()");
+    Packet* frame = check_and_cast<Packet*>(packet);
+
+    Entry entry;
+    entry.requestBits = LengthAwareQueue::requestBits(packet);
+    entry.eligibilityTime = simTime();
+    entry.sequence = nextSequence++;
+    entry.packet = packet;
+
+    Shaper* shaper = findShaper(frame);
+    if (shaper != nullptr) {
+        entry.eligibilityTime = eligibilityTime(*shaper,
+                Ieee8021q::getFinalEthernet2FrameBitLength(frame), simTime());
+        if (maxResidenceTime > SIMTIME_ZERO
+                && entry.eligibilityTime > simTime() + maxResidenceTime) {
+            EV_TRACE << getFullPath() << ": Discard packet with eligibility "
+                            << "time " << entry.eligibilityTime << "." << endl;
+            numPacketsDiscarded++;
+            return false;
+        }
+        numPacketsShaped++;
+    }
+
+    emit(eligibilityDelaySignal, entry.eligibilityTime - simTime());
+    eligibilityQueue.push(entry);
+    return true;
+}
+
+void AsynchronousTrafficShaper::rescheduleEligibilityTime() {
+    cancelEvent(&eligibilityTimeMsg);
+    if (!eligibilityQueue.empty()
+            && eligibilityQueue.top().eligibilityTime > simTime()) {
+        scheduleAt(eligibilityQueue.top().eligibilityTime,
+                &eligibilityTimeMsg);
+    }
+}
+
+void AsynchronousTrafficShaper::handleEligibilityTimeEvent() {
+    EV_TRACE << getFullPath() << ": Handle eligibility-time event." << endl;
+
+    queueStateChanged();
+    transmissionGate->packetEnqueued();
+}
+
+void AsynchronousTrafficShaper::handlePacketEnqueuedEvent() {
+    EV_TRACE << getFullPath() << ": Handle packet-enqueued event." << endl;
+
+    rescheduleEligibilityTime();
+    if (isEligible()) {
+        transmissionGate->packetEnqueued();
+    }
+}
+
+void AsynchronousTrafficShaper::handleRequestPacketEvent(uint64_t maxBits) {
+    ASSERT(!isEmpty(maxBits));
+
+    EV_TRACE << getFullPath() << ": Handle request-packet event (" << maxBits
+                    << " bits)." << endl;
+
+    queue->requestPacket(maxBits, removeEligiblePacket());
+}
+
+cPacket* AsynchronousTrafficShaper::pop(uint64_t maxBits) {
+    Enter_Method("pop(maxBits)");
+    ASSERT(!isEmpty(maxBits));
+    return queue->pop(maxBits, removeEligiblePacket());
+}
+
+cPacket* AsynchronousTrafficShaper::removeEligiblePacket() {
+    cPacket* packet = eligibilityQueue.top().packet;
+    eligibilityQueue.pop();
+    rescheduleEligibilityTime();
+    return packet;
+}
+
+bool AsynchronousTrafficShaper::isEmpty(uint64_t maxBits) {
+    return !isEligible() || eligibilityQueue.top().requestBits > maxBits;
+}
+
+bool AsynchronousTrafficShaper::isStateless() {
+    return false;
+}
+
+bool AsynchronousTrafficShaper::isEligible() {
+    return !eligibilityQueue.empty()
+            && eligibilityQueue.top().eligibilityTime <= simTime();
+}
+
+} // namespace nesting
@@ -0,0 +1,170 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __MAIN_ASYNCHRONOUSTRAFFICSHAPER_H_
+#define __MAIN_ASYNCHRONOUSTRAFFICSHAPER_H_
+
+#include <omnetpp.h>
+#include <queue>
+#include <vector>
+
+#include "inet/common/packet/Packet.h"
+
+#include "TSAlgorithm.h"
+#include "../StreamClassifier.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * See the NED file for a detailed description.
+ */
+class AsynchronousTrafficShaper: public TSAlgorithm {
+protected:
+    /** Token bucket state of a stream. */
+    struct Shaper {
+        /** Committed information rate in bits per second. */
+        double committedInformationRate;
+
+        /** Time needed to fill the empty token bucket. */
+        simtime_t emptyToFullDuration;
+
+        /** Time at which the token bucket was or will be empty. */
+        simtime_t bucketEmptyTime;
+
+        /** Index of the shaper group of the stream. */
+        int group;
+    };
+
+    /** Frame waiting for its eligibility time. */
+    struct Entry {
+        simtime_t eligibilityTime;
+
+        /** Arrival order, breaks ties between equal eligibility times. */
+        uint64_t sequence;
+
+        /**
+         * Bits the frame needs in a packet request, as counted by the input
+         * queue.
+         */
+        uint64_t requestBits;
+
+        cPacket* packet;
+
+        bool operator>(const Entry& other) const {
+            return eligibilityTime != other.eligibilityTime ?
+                    eligibilityTime > other.eligibilityTime :
+                    sequence > other.sequence;
+        }
+    };
+
+    /** Maps frames to the index of their shaper. */
+    StreamClassifier classifier;
+
+    /**
+     * Shapers of the configured streams, followed by the shaper of all other
+     * frames.
+     */
+    std::vector<Shaper> shapers;
+
+    /** Group eligibility time per shaper group. */
+    std::vector<simtime_t> groupEligibilityTimes;
+
+    /** False if frames of no configured stream are not shaped. */
+    bool shapeOtherFrames;
+
+    /**
+     * Frames are discarded if their eligibility time is later than their
+     * arrival plus this time. Zero if frames are never discarded.
+     */
+    simtime_t maxResidenceTime;
+
+    /** Queued frames ordered by eligibility time. */
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> eligibilityQueue;
+
+    uint64_t nextSequence = 0;
+
+    /** Self message for the eligibility time of the first queued frame. */
+    cMessage eligibilityTimeMsg = cMessage("eligibilityTime");
+
+    simsignal_t eligibilityDelaySignal;
+
+    long numPacketsShaped = 0;
+
+    long numPacketsDiscarded = 0;
+
+protected:
+    /** @copydoc cSimpleModule::initialize() */
+    virtual void initialize() override;
+
+    /** @copydoc cSimpleModule::handleMessage(cMessage*) */
+    virtual void handleMessage(cMessage* msg) override;
+
+    /** @copydoc cSimpleModule::finish() */
+    virtual void finish() override;
+
+    /** Adds a shaper and, unless given, a shaper group of its own. */
+    virtual void addShaper(double committedInformationRate,
+            double committedBurstSize, int group);
+
+    /** Returns the shaper of a frame, or nullptr if it is not shaped. */
+    virtual Shaper* findShaper(Packet* packet);
+
+    /**
+     * Computes the eligibility time of a frame from the token bucket state of
+     * its shaper and the eligibility time of its shaper group. The state is
+     * only updated if the frame is not discarded.
+     */
+    virtual simtime_t eligibilityTime(Shaper& shaper, uint64_t frameBits,
+            simtime_t arrivalTime);
+
+    /**
+     * Schedules eligibilityTimeMsg for the first queued frame if that frame
+     * is not eligible yet.
+     */
+    virtual void rescheduleEligibilityTime();
+
+    /**
+     * Handles the first queued frame becoming eligible for transmission.
+     */
+    virtual void handleEligibilityTimeEvent();
+
+    virtual void handlePacketEnqueuedEvent() override;
+
+    virtual void handleRequestPacketEvent(uint64_t maxBits) override;
+
+    /** Removes the first frame from the eligibility queue and returns it. */
+    virtual cPacket* removeEligiblePacket();
+
+public:
+    virtual ~AsynchronousTrafficShaper();
+
+    virtual bool admitPacket(cPacket* packet) override;
+
+    virtual bool isEmpty(uint64_t maxBits) override;
+
+    virtual cPacket* pop(uint64_t maxBits) override;
+
+    /** Returns true if the first queued frame is eligible. */
+    virtual bool isEligible() override;
+
+    /** Returns false, because every transmission updates a token bucket. */
+    virtual bool isStateless() override;
+};
+
+} // namespace nesting
+
+#endif
@@ -30,6 +30,9 @@ void CreditBasedShaper::initialize() {
     // Initialize credit value
     credit = 0;
     WATCH(credit);
+    creditSignal = registerSignal("credit");
+    emittedCredit = credit;
+    emit(creditSignal, credit);
 
     // Initialize idle slope value
     idleSlopeFactor = par("idleSlopeFactor");
@@ -129,6 +132,8 @@ void CreditBasedShaper::spendCredit(Packet* packet) {
     double spendCredit = creditsForTime(getSendSlope(),
             transmissionTime(packet));
     credit -= spendCredit;
+    emitCredit(simTime());
+    transmissionGate->updateSelectionState();
 
     EV_DEBUG << getFullPath() << ": Spending " << spendCredit
                     << " credit to transmit "
@@ -140,6 +145,8 @@ void CreditBasedShaper::spendCredit(Packet* packet) {
 void CreditBasedShaper::earnCredits(simtime_t time) {
     double earnedCredit = creditsForTime(getIdleSlope(), time);
     credit += earnedCredit;
+    emitCredit(simTime());
+    transmissionGate->updateSelectionState();
 
     EV_DEBUG << getFullPath() << ": Earned " << earnedCredit << " credit."
                     << endl;
@@ -147,10 +154,25 @@ void CreditBasedShaper::earnCredits(simtime_t time) {
 
 void CreditBasedShaper::resetCredit() {
     credit = 0;
+    emitCredit(simTime());
+    transmissionGate->updateSelectionState();
 
     EV_DEBUG << getFullPath() << ": Resetted credit." << endl;
 }
 
+void CreditBasedShaper::emitCredit(simtime_t time) {
+    if (credit == emittedCredit) {
+        return;
+    }
+    emittedCredit = credit;
+    if (time == simTime()) {
+        emit(creditSignal, credit);
+    } else {
+        cTimestampedValue value(time, credit);
+        emit(creditSignal, &value);
+    }
+}
+
 bool CreditBasedShaper::isCreditPositive() {
     return static_cast<int>(credit) >= 0;
 }
@@ -205,6 +227,17 @@ void CreditBasedShaper::handlePacketEnqueuedEvent() {
     }
 }
 
+bool CreditBasedShaper::isStateless() {
+    return false;
+}
+
+cPacket* CreditBasedShaper::pop(uint64_t maxBits) {
+    Enter_Method("pop(maxBits)");
+    Packet* packet = check_and_cast<Packet*>(TSAlgorithm::pop(maxBits));
+    handleSendPacketEvent(packet);
+    return packet;
+}
+
 void CreditBasedShaper::handleSendPacketEvent(Packet* packet) {
     assert(state != kSpendCredit);
     assert(isCreditPositive());
@@ -262,4 +295,8 @@ bool CreditBasedShaper::isEmpty(uint64_t maxBits) {
     return !isCreditPositive() || queue->isEmpty(maxBits);
 }
 
+bool CreditBasedShaper::isEligible() {
+    return isCreditPositive();
+}
+
 } // namespace nesting
@@ -28,10 +28,14 @@ using namespace omnetpp;
 
 namespace nesting {
 
+template<unsigned int N, typename Shaper> class SelectionCore;
+
 /**
  * See the NED file for a detailed description.
  */
 class CreditBasedShaper: public TSAlgorithm {
+    // Checks the credit without virtual dispatch
+    template<unsigned int N, typename Shaper> friend class SelectionCore;
 protected:
     /**
      * Enumeration to represent the internal state of the credit-based-shaper
@@ -75,6 +79,12 @@ protected:
      * packet-enqueued event subsequent queuing components.
      */
     cMessage reachedZeroCreditMessage = cMessage("reachedZeroCredit");
+
+    /** Emitted with the new credit value whenever the credit changes. */
+    simsignal_t creditSignal;
+
+    /** Last credit value emitted as creditSignal. */
+    double emittedCredit;
 protected:
     /** @copydoc cSimpleModule::initialize() */
     virtual void initialize() override;
@@ -146,6 +156,12 @@ protected:
     /** Resets credit to zero. */
     virtual void resetCredit();
 
+    /**
+     * Emits the credit with the time it changed, unless it is unchanged since
+     * the last emit. Values for a past time are emitted as cTimestampedValue.
+     */
+    virtual void emitCredit(simtime_t time);
+
     /** Returns true if credit is greater or equal to zero. */
     virtual bool isCreditPositive();
 
@@ -186,6 +202,15 @@ public:
     ~CreditBasedShaper();
 
     virtual bool isEmpty(uint64_t maxBits) override;
+
+    /** Spends the credit for the returned packet like handleMessage(). */
+    virtual cPacket* pop(uint64_t maxBits) override;
+
+    /** Returns true if credit is greater or equal to zero. */
+    virtual bool isEligible() override;
+
+    /** Returns false, because every transmission spends credit. */
+    virtual bool isStateless() override;
 };
 
 } // namespace nesting
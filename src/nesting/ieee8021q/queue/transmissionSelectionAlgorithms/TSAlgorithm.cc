@@ -89,8 +89,35 @@ void TSAlgorithm::requestPacket(uint64_t maxBits) {
     maxTransmittableBits = maxBits;
     scheduleAt(simTime(), &requestPacketMsg);
 }
+
+cPacket* TSAlgorithm::pop(uint64_t maxBits) {
+    Enter_Method("pop(maxBits)");
+    ASSERT(!isEmpty(maxBits));
+    return queue->pop(maxBits);
+}
+
 bool TSAlgorithm::isExpressQueue() {
     return queue->isExpressQueue();
 }
+
+bool TSAlgorithm::isQueueEmpty() {
+    return queue->getLength() == 0;
+}
+
+bool TSAlgorithm::isStateless() {
+    return true;
+}
+
+bool TSAlgorithm::isEligible() {
+    return true;
+}
+
+bool TSAlgorithm::admitPacket(cPacket* packet) {
+    return true;
+}
+
+void TSAlgorithm::queueStateChanged() {
+    transmissionGate->updateSelectionState();
+}
 }
 /* namespace nesting */
@@ -89,8 +89,49 @@ public:
 
     virtual void requestPacket(uint64_t maxBits);
 
+    /**
+     * Removes and returns the packet that requestPacket(maxBits) would
+     * deliver, without any intermediate event. The caller has to take
+     * ownership.
+     */
+    virtual cPacket* pop(uint64_t maxBits);
+
     virtual bool isExpressQueue();
 
+    /**
+     * Returns true if the input queue holds no packets at all, independent of
+     * their size.
+     */
+    virtual bool isQueueEmpty();
+
+    /**
+     * Returns true if the algorithm's internal state (e.g. credit) allows a
+     * transmission right now, independent of the input queue state.
+     */
+    virtual bool isEligible();
+
+    /**
+     * Returns true if transmitting packets does not change the algorithm's
+     * state, so that several packets may be taken at once, e.g. for strict
+     * priority.
+     */
+    virtual bool isStateless();
+
+    /**
+     * Called by the input queue for every arriving packet before it is
+     * enqueued. Returns false if the packet has to be dropped.
+     */
+    virtual bool admitPacket(cPacket* packet);
+
+    /**
+     * Called by the input queue whenever packets were enqueued or dequeued.
+     */
+    virtual void queueStateChanged();
+
+    LengthAwareQueue* getQueue() const {
+        return queue;
+    }
+
 };
 
 } /* namespace nesting */
@@ -15,17 +15,25 @@
 
 #include "FilteringDatabase.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
 namespace nesting {
 
 Define_Module(FilteringDatabase);
 
-FilteringDatabase::FilteringDatabase() {
+FilteringDatabase::FilteringDatabase() :
+        adminVlanMembers(kMaxValidVID + 1, kVlanNotDeclared),
+        operVlanMembers(kMaxValidVID + 1, kVlanNotDeclared) {
     this->agingActive = false;
     this->agingThreshold = 0;
 }
 
 FilteringDatabase::FilteringDatabase(bool agingActive,
-        simtime_t agingThreshold) {
+        simtime_t agingThreshold) :
+        adminVlanMembers(kMaxValidVID + 1, kVlanNotDeclared),
+        operVlanMembers(kMaxValidVID + 1, kVlanNotDeclared) {
     this->agingActive = agingActive;
     this->agingThreshold = agingThreshold;
 }
@@ -35,9 +43,13 @@ FilteringDatabase::~FilteringDatabase() {
 
 void FilteringDatabase::clearAdminFdb() {
     adminFdb.clear();
+    adminPortSets.clear();
+    std::fill(adminVlanMembers.begin(), adminVlanMembers.end(),
+            kVlanNotDeclared);
 }
 void FilteringDatabase::initialize(int stage) {
     if (stage == INITSTAGE_LOCAL) {
+        numberOfPorts = par("numberOfPorts");
         cXMLElement* fdb = par("database");
         cXMLElement* cycleXml = par("cycle");
         cycle = atoi(cycleXml->getFirstChildWithTag("cycle")->getNodeValue());
@@ -46,9 +58,37 @@ void FilteringDatabase::initialize(int stage) {
         cModule* clockModule = getModuleByPath(par("clockModule"));
         clock = check_and_cast<IClock*>(clockModule);
 
+        if (par("agingTime").doubleValue() > 0) {
+            agingActive = true;
+            agingThreshold = par("agingTime");
+        }
+        agingResolution = par("agingResolution");
+        learnedEntriesSignal = registerSignal("learnedEntries");
+        agedEntriesSignal = registerSignal("agedEntries");
+        WATCH(numLearnedEntries);
+        WATCH(numAgedEntries);
+
 //    WATCH_MAP(fdb)
     } else if (stage == INITSTAGE_LINK_LAYER) {
         clock->subscribeTick(this, 0);
+        if (agingActive) {
+            // The clock is initialized in the first stage
+            simtime_t clockRate = clock->getClockRate();
+            int64_t ticks = agingResolution.raw() / clockRate.raw();
+            if (ticks <= 0 || ticks * clockRate.raw() != agingResolution.raw()) {
+                throw cRuntimeError(
+                        "agingResolution must be a positive multiple of the clock rate.");
+            }
+            agingTicks = static_cast<unsigned int>(ticks);
+            clock->subscribeTick(&agingClockListener, agingTicks);
+        }
+    }
+}
+
+void FilteringDatabase::finish() {
+    recordScalar("agedEntries", numAgedEntries);
+    if (simTime() > SIMTIME_ZERO) {
+        recordScalar("agingRate", numAgedEntries / simTime().dbl(), "1/s");
     }
 }
 
@@ -84,6 +124,9 @@ void FilteringDatabase::loadDatabase(cXMLElement* xml, int cycle) {
     if (staticRules != nullptr) {
         clearAdminFdb();
 
+        // VLANs first, entries with VIDs declare missing VLANs
+        this->parseVlans(staticRules);
+
         cXMLElement* forwardingXml = staticRules->getFirstChildWithTag(
                 "forward");
         if (forwardingXml != nullptr) {
@@ -95,6 +138,59 @@ void FilteringDatabase::loadDatabase(cXMLElement* xml, int cycle) {
 
 }
 
+void FilteringDatabase::parseVlans(cXMLElement* xml) {
+    for (cXMLElement* vlan : xml->getChildrenByTagName("vlan")) {
+        const char* vidString = vlan->getAttribute("vid");
+        int vid = vidString ? atoi(vidString) : 0;
+        if (vid < kMinValidVID || vid > kMaxValidVID) {
+            throw cRuntimeError(
+                    "vlan tag in forwarding database XML must have a vid "
+                            "attribute between %d and %d", kMinValidVID,
+                    kMaxValidVID);
+        }
+        const char* portsString = vlan->getAttribute("ports");
+        adminVlanMembers[vid] =
+                portsString ? parsePortSet(portsString) : kAllPorts;
+    }
+}
+
+int FilteringDatabase::parsePortSet(const char* ports) {
+    PortSet portSet;
+    cStringTokenizer tokenizer(ports, " ,");
+    while (tokenizer.hasMoreTokens()) {
+        const char* token = tokenizer.nextToken();
+        char* end;
+        long port = strtol(token, &end, 10);
+        if (*end != '\0' || port < 0 || port >= numberOfPorts) {
+            throw cRuntimeError(
+                    "Invalid port '%s' in forwarding database XML, the "
+                            "switch has %d ports.", token, numberOfPorts);
+        }
+        portSet.add(static_cast<int>(port));
+    }
+    if (portSet.empty()) {
+        throw cRuntimeError("Empty port list '%s' in forwarding database XML.",
+                ports);
+    }
+    adminPortSets.push_back(std::move(portSet));
+    return static_cast<int>(adminPortSets.size()) - 1;
+}
+
+int FilteringDatabase::parseEntryVid(cXMLElement* xml) {
+    const char* vidString = xml->getAttribute("vid");
+    if (vidString == nullptr) {
+        return 0;
+    }
+    int vid = atoi(vidString);
+    if (vid < 0 || vid > kMaxValidVID) {
+        throw cRuntimeError("Invalid VID %d in forwarding database XML.", vid);
+    }
+    if (vid != 0 && adminVlanMembers[vid] == kVlanNotDeclared) {
+        adminVlanMembers[vid] = kAllPorts;
+    }
+    return vid;
+}
+
 void FilteringDatabase::parseEntries(cXMLElement* xml) {
     // If present get rules from XML file
     if (xml == nullptr) {
@@ -120,28 +216,26 @@ void FilteringDatabase::parseEntries(cXMLElement* xml) {
                             "port attribute");
         }
 
-        std::vector<int> port;
-        port.insert(port.begin(), 1,
-                atoi(individualAddress->getAttribute("port")));
-
-        uint8_t vid = 0;
-        if (individualAddress->getAttribute("vid"))
-            vid = static_cast<uint8_t>(atoi(
-                    individualAddress->getAttribute("vid")));
-
-        // Create and insert entry for different individual address types
-        if (vid == 0) {
-            MacAddress macAddress;
-            if (!macAddress.tryParse(macAddressStr.c_str())) {
-                throw new cRuntimeError("Cannot parse invalid Mac address.");
-            }
-            adminFdb.insert( { macAddress,
-                    std::pair<simtime_t, std::vector<int>>(0, port) });
-        } else {
-            // TODO
+        Entry entry;
+        entry.port = atoi(individualAddress->getAttribute("port"));
+        if (entry.port < 0 || entry.port >= numberOfPorts) {
             throw cRuntimeError(
-                    "Individual address rules with VIDs aren't supported yet");
+                    "Invalid port %d in forwarding database XML, the switch "
+                            "has %d ports.", entry.port, numberOfPorts);
+        }
+
+        int vid = parseEntryVid(individualAddress);
+        MacAddress macAddress;
+        if (!macAddress.tryParse(macAddressStr.c_str())) {
+            throw new cRuntimeError("Cannot parse invalid Mac address.");
+        }
+        if (macAddress.isMulticast()) {
+            // Looked up like multicast entries
+            adminPortSets.emplace_back();
+            adminPortSets.back().add(entry.port);
+            entry.portSet = static_cast<int>(adminPortSets.size()) - 1;
         }
+        adminFdb.insert(packKey(vid, macAddress), entry);
     }
 
     // Rules for multicastAddresses
@@ -161,42 +255,31 @@ void FilteringDatabase::parseEntries(cXMLElement* xml) {
                     "multicastAddress tag in forwarding database XML must have an "
                             "ports attribute");
         }
-        std::string portsString = multicastAddress->getAttribute("ports");
-        std::vector<int> port;
-        unsigned int i = 0;
-        while (i <= portsString.length()) {
-            port.push_back(portsString[i] - '0');
-            i += 2;
-        }
-
-        uint8_t vid = 0;
-        if (multicastAddress->getAttribute("vid"))
-            vid = static_cast<uint8_t>(atoi(
-                    multicastAddress->getAttribute("vid")));
+        Entry entry;
+        entry.portSet = parsePortSet(multicastAddress->getAttribute("ports"));
 
-        // Create and insert entry for different individual address types
-        if (vid == 0) {
-            MacAddress macAddress;
-            if (!macAddress.tryParse(macAddressStr.c_str())) {
-                throw new cRuntimeError("Cannot parse invalid Mac address.");
-            }
-            if (!macAddress.isMulticast()) {
-                throw new cRuntimeError(
-                        "Mac address is not a Multicast address.");
-            }
-            adminFdb.insert( { macAddress,
-                    std::pair<simtime_t, std::vector<int>>(0, port) });
-        } else {
-            // TODO
-            throw cRuntimeError(
-                    "Multicast address rules with VIDs aren't supported yet");
+        int vid = parseEntryVid(multicastAddress);
+        MacAddress macAddress;
+        if (!macAddress.tryParse(macAddressStr.c_str())) {
+            throw new cRuntimeError("Cannot parse invalid Mac address.");
+        }
+        if (!macAddress.isMulticast()) {
+            throw new cRuntimeError(
+                    "Mac address is not a Multicast address.");
         }
+        adminFdb.insert(packKey(vid, macAddress), entry);
     }
 }
 
 void FilteringDatabase::tick(IClock *clock) {
     if (changeDatabase) {
+        // Learned entries are dropped with the old table, their timers in
+        // the aging wheel find no entry any more
         operFdb.swap(adminFdb);
+        operPortSets.swap(adminPortSets);
+        operVlanMembers.swap(adminVlanMembers);
+        numLearnedEntries = 0;
+        emit(learnedEntriesSignal, numLearnedEntries);
         cycle = newCycle;
         clearAdminFdb();
 
@@ -212,69 +295,118 @@ void FilteringDatabase::handleMessage(cMessage *msg) {
     throw cRuntimeError("Must not receive messages.");
 }
 
-void FilteringDatabase::insert(MacAddress macAddress, simtime_t curTS,
-        int port) {
-    std::vector<int> tmp;
-    tmp.insert(tmp.begin(), 1, port);
-    operFdb[macAddress] = std::pair<simtime_t, std::vector<int>>(curTS, tmp);
+void FilteringDatabase::handleAgingTick() {
+    Enter_Method_Silent();
+    long numAgedBefore = numAgedEntries;
+    agingWheel.advance([this](uint64_t key) {
+        Entry* entry = operFdb.find(key);
+        // Timers of removed or rescheduled entries are ignored
+        if (entry == nullptr || !entry->learned
+                || entry->agingTick != agingWheel.getCurrentTick()) {
+            return;
+        }
+        if (isExpired(*entry, simTime())) {
+            eraseExpired(key);
+        } else {
+            scheduleAging(key, *entry);
+        }
+    });
+    if (numAgedEntries > numAgedBefore) {
+        emit(agedEntriesSignal, numAgedEntries - numAgedBefore);
+        emit(learnedEntriesSignal, numLearnedEntries);
+    }
+    clock->subscribeTick(&agingClockListener, agingTicks);
+}
+
+void FilteringDatabase::scheduleAging(uint64_t key, Entry& entry) {
+    simtime_t remaining = entry.timestamp + agingThreshold - simTime();
+    int64_t ticks = static_cast<int64_t>(std::ceil(remaining / agingResolution));
+    entry.agingTick = agingWheel.getCurrentTick() + (ticks > 0 ? ticks : 1);
+    agingWheel.schedule(key, entry.agingTick);
 }
 
-int FilteringDatabase::getPort(MacAddress macAddress, simtime_t curTS) {
-    simtime_t ts;
-    std::vector<int> port;
+void FilteringDatabase::eraseExpired(uint64_t key) {
+    operFdb.erase(key);
+    numLearnedEntries--;
+    numAgedEntries++;
+}
+
+void FilteringDatabase::insert(MacAddress macAddress, int vid,
+        simtime_t curTS, int port) {
+    uint64_t key = packKey(learningVid(vid), macAddress);
+    Entry* entry = operFdb.find(key);
+    if (entry == nullptr) {
+        entry = &operFdb[key];
+        entry->learned = true;
+        numLearnedEntries++;
+        emit(learnedEntriesSignal, numLearnedEntries);
+        if (agingActive) {
+            entry->timestamp = curTS;
+            scheduleAging(key, *entry);
+        }
+    } else if (!entry->learned) {
+        // Static entries are not overwritten by learning
+        return;
+    }
+    entry->timestamp = curTS;
+    entry->port = port;
+    entry->portSet = -1;
+}
 
-    auto it = operFdb.find(macAddress);
+int FilteringDatabase::getPort(MacAddress macAddress, int vid,
+        simtime_t curTS) {
+    uint64_t key = packKey(learningVid(vid), macAddress);
+    Entry* entry = operFdb.find(key);
 
     //is element available?
-    if (it != operFdb.end()) {
-        ts = it->second.first;
-        port = it->second.second;
+    if (entry != nullptr) {
         // return if mac address belongs to multicast
-        if (port.size() != 1) {
+        if (entry->port < 0) {
             return -1;
         }
-        // static entries (ts == 0) do not age
-        if (!agingActive || (ts == 0 || curTS - ts < agingThreshold)) {
-            operFdb[macAddress] = std::pair<simtime_t, std::vector<int>>(curTS,
-                    port);
-            return port.at(0);
+        if (!isExpired(*entry, curTS)) {
+            // static entries do not age
+            if (entry->learned) {
+                entry->timestamp = curTS;
+            }
+            return entry->port;
         } else {
-            operFdb.erase(macAddress);
+            eraseExpired(key);
+            emit(agedEntriesSignal, 1L);
+            emit(learnedEntriesSignal, numLearnedEntries);
         }
     }
 
     return -1;
 }
 
-std::vector<int> FilteringDatabase::getPorts(MacAddress macAddress,
+const PortSet* FilteringDatabase::getPorts(MacAddress macAddress, int vid,
         simtime_t curTS) {
-    simtime_t ts;
-    std::vector<int> ports;
-
     if (!macAddress.isMulticast()) {
-        ports.push_back(-1);
-        return ports;
+        return nullptr;
     }
 
-    auto it = operFdb.find(macAddress);
+    uint64_t key = packKey(learningVid(vid), macAddress);
+    Entry* entry = operFdb.find(key);
 
     //is element available?
-    if (it != operFdb.end()) {
-        ts = it->second.first;
-        ports = it->second.second;
-        // static entries (ts == 0) do not age
-        if (!agingActive || (ts == 0 || curTS - ts < agingThreshold)) {
-            operFdb[macAddress] = std::pair<simtime_t, std::vector<int>>(curTS,
-                    ports);
-            return ports;
+    if (entry != nullptr) {
+        if (!isExpired(*entry, curTS)) {
+            if (entry->learned) {
+                entry->timestamp = curTS;
+            }
+            if (entry->portSet >= 0) {
+                return &operPortSets[entry->portSet];
+            }
         } else {
-            operFdb.erase(macAddress);
+            eraseExpired(key);
+            emit(agedEntriesSignal, 1L);
+            emit(learnedEntriesSignal, numLearnedEntries);
         }
 
     }
 
-    ports.push_back(-1);
-    return ports;
+    return nullptr;
 }
 
 } // namespace nesting
@@ -17,34 +17,88 @@
 #define __MAIN_FILTERINGDATABASE_H_
 
 #include <omnetpp.h>
-#include <tuple>
-#include <unordered_map>
+#include <vector>
 
 #include "inet/linklayer/common/MacAddress.h"
 #include "../clock/IClockListener.h"
+#include "../../common/containers/FlatHashMap.h"
+#include "../../common/containers/PortSet.h"
+#include "../../common/containers/TimerWheel.h"
+#include "../Ieee8021q.h"
 
 using namespace omnetpp;
 using namespace inet;
 
-//added hash function for MacAddress (required for map)
-namespace std {
-template<> struct hash<MacAddress> {
-    size_t operator()(MacAddress const& mac) const noexcept
-    {
-        return std::hash<string> { }(mac.str());
-    }
-};
-}
-
 namespace nesting {
 
 /**
  * See the NED file for a detailed description
  */
 class FilteringDatabase: public cSimpleModule, public IClockListener {
+protected:
+    /** Forwarding information of one MAC address. */
+    struct Entry {
+        /** Time of the last use of a learned entry. */
+        simtime_t timestamp;
+
+        /** True for learned entries, static entries do not age. */
+        bool learned = false;
+
+        /** Aging wheel tick at which a learned entry is checked next. */
+        uint64_t agingTick = 0;
+
+        /** Port of an individual address, -1 for multicast entries. */
+        int port = -1;
+
+        /**
+         * Index of the port set of a multicast address in the port sets of
+         * the table, -1 for individual addresses.
+         */
+        int portSet = -1;
+    };
+
+    /** Port set index of VLANs that are not declared. */
+    static const int kVlanNotDeclared = -1;
+
+    /** Port set index of declared VLANs with all ports as members. */
+    static const int kAllPorts = -2;
+
+    typedef FlatHashMap<Entry> Table;
+
+    /** Forwards the ticks of the aging subscription to handleAgingTick(). */
+    class AgingClockListener: public IClockListener {
+    private:
+        FilteringDatabase* filteringDatabase;
+    public:
+        explicit AgingClockListener(FilteringDatabase* filteringDatabase) :
+                filteringDatabase(filteringDatabase) {
+        }
+        virtual void tick(IClock *clock) override {
+            filteringDatabase->handleAgingTick();
+        }
+    };
 private:
-    std::unordered_map<MacAddress, std::pair<simtime_t, std::vector<int>>> adminFdb;
-    std::unordered_map<MacAddress, std::pair<simtime_t, std::vector<int>>> operFdb;
+    /**
+     * Tables keyed on the VID and the 48 bit MAC address packed by packKey().
+     * The admin table is filled from the configuration and replaces the oper
+     * table on the next cycle.
+     */
+    Table adminFdb;
+    Table operFdb;
+
+    /**
+     * Port sets of the multicast entries and VLANs, referenced by index.
+     * Swapped together with the tables.
+     */
+    std::vector<PortSet> adminPortSets;
+    std::vector<PortSet> operPortSets;
+
+    /**
+     * Port set index of the member ports per VID, or kVlanNotDeclared or
+     * kAllPorts. Swapped together with the tables.
+     */
+    std::vector<int> adminVlanMembers;
+    std::vector<int> operVlanMembers;
 
     bool changeDatabase = false;
 
@@ -53,15 +107,80 @@ private:
      */
     IClock* clock;
 
+    /** Number of ports of the switch, checked for configured ports. */
+    int numberOfPorts = 0;
+
     int cycle = 100;
     int newCycle = 100;
 
     bool agingActive = false;
     simtime_t agingThreshold;
 
+    /**
+     * Learned entries by the aging tick at which they are checked. An entry
+     * that was used in the meantime is scheduled again for its new expiry
+     * time instead of being moved on every use.
+     */
+    TimerWheel agingWheel;
+
+    /** Time between two aging ticks. */
+    simtime_t agingResolution;
+
+    /** Clock ticks between two aging ticks. */
+    unsigned int agingTicks = 0;
+
+    AgingClockListener agingClockListener { this };
+
+    /** Number of learned entries in the oper table. */
+    long numLearnedEntries = 0;
+
+    /** Number of learned entries removed because they expired. */
+    long numAgedEntries = 0;
+
+    simsignal_t learnedEntriesSignal;
+    simsignal_t agedEntriesSignal;
+
     void parseEntries(cXMLElement* xml);
+    void parseVlans(cXMLElement* xml);
     void clearAdminFdb();
 
+    /**
+     * Reads the vid attribute of a static entry, 0 if absent. Declares the
+     * VLAN with all ports as members if it was not declared before.
+     */
+    int parseEntryVid(cXMLElement* xml);
+
+    /**
+     * Parses a list of port numbers separated by spaces or commas into a new
+     * admin port set and returns its index. Ports must be below
+     * numberOfPorts.
+     */
+    int parsePortSet(const char* ports);
+
+    /**
+     * Returns the VID whose entries are used for frames of a VLAN, which is
+     * the VID itself for declared VLANs and 0 otherwise.
+     */
+    int learningVid(int vid) const {
+        return vid > 0 && vid <= kMaxValidVID
+                && operVlanMembers[vid] != kVlanNotDeclared ? vid : 0;
+    }
+
+    /**
+     * Returns true if an entry is too old to be used. Aging entries are
+     * erased on lookup.
+     */
+    bool isExpired(const Entry& entry, simtime_t curTS) const {
+        return agingActive && entry.learned
+                && curTS - entry.timestamp >= agingThreshold;
+    }
+
+    /** Schedules the aging check of a learned entry for its expiry time. */
+    void scheduleAging(uint64_t key, Entry& entry);
+
+    /** Removes an expired learned entry from the oper table. */
+    void eraseExpired(uint64_t key);
+
 protected:
     virtual void initialize(int stage) override;
 
@@ -69,6 +188,13 @@ protected:
 
     virtual int numInitStages() const override;
 
+    virtual void finish() override;
+
+    /**
+     * Removes the learned entries that expired since the last aging tick.
+     */
+    virtual void handleAgingTick();
+
 public:
     FilteringDatabase(bool agingActive, simtime_t agingTreshold);
     FilteringDatabase();
@@ -79,11 +205,31 @@ public:
 
     virtual void loadDatabase(cXMLElement* fdb, int cycle);
 
-    virtual int getPort(MacAddress macAddress, simtime_t curTS);
+    /** Packs a VID and a MAC address into a table key. */
+    static uint64_t packKey(int vid, const MacAddress& macAddress) {
+        return (static_cast<uint64_t>(vid & 0xFFF) << 48)
+                | macAddress.getInt();
+    }
+
+    virtual int getPort(MacAddress macAddress, int vid, simtime_t curTS);
 
-    virtual std::vector<int> getPorts(MacAddress macAddress, simtime_t curTS);
+    /**
+     * Returns the ports a multicast address is forwarded to, or nullptr if
+     * there is no entry for it. The set is valid until the next cycle.
+     */
+    virtual const PortSet* getPorts(MacAddress macAddress, int vid,
+            simtime_t curTS);
+
+    void insert(MacAddress macAddress, int vid, simtime_t curTS, int port);
 
-    void insert(MacAddress macAddress, simtime_t curTS, int port);
+    /**
+     * Returns the member ports of a VLAN, or nullptr if all ports are
+     * members. The set is valid until the next cycle.
+     */
+    const PortSet* getVlanMembers(int vid) const {
+        int index = learningVid(vid) == 0 ? kAllPorts : operVlanMembers[vid];
+        return index >= 0 ? &operPortSets[index] : nullptr;
+    }
 };
 
 } // namespace nesting
@@ -27,15 +27,23 @@ void FloodingRelayUnit::initialize() {
 }
 
 void FloodingRelayUnit::handleMessage(cMessage *msg) {
+    // Every port but the last one gets a copy, the last one the message
+    // itself
+    cGate* lastGate = nullptr;
     for (int i = 0; i < gateSize("out"); i++) {
-        cGate *outputGate = gate("out", i);
         if (!msg->arrivedOn("in", i)) {
-            cMessage* dupMsg = msg->dup();
-            send(dupMsg, outputGate);
+            if (lastGate != nullptr) {
+                send(msg->dup(), lastGate);
+            }
+            lastGate = gate("out", i);
         }
     }
 
-    delete msg;
+    if (lastGate != nullptr) {
+        send(msg, lastGate);
+    } else {
+        delete msg;
+    }
 }
 
 } // namespace nesting
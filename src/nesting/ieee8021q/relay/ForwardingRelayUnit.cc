@@ -24,87 +24,121 @@ void ForwardingRelayUnit::initialize() {
     fdb = getModuleFromPar<FilteringDatabase>(par("filteringDatabaseModule"),
             this);
     numberOfPorts = par("numberOfPorts");
+    outGates.resize(numberOfPorts);
+    for (int portId = 0; portId < numberOfPorts; portId++) {
+        outGates[portId] = gate("out", portId);
+    }
+    WATCH(numPacketCopies);
 }
 
 void ForwardingRelayUnit::handleMessage(cMessage *msg) {
     Packet* packet = check_and_cast<Packet*>(msg);
     auto macTag = packet->getTag<MacAddressInd>();
+    int vid = getVid(packet);
 
     // Distinguish between broadcast-, multicast- and unicast-ethernet frames
     if (macTag->getDestAddress().isBroadcast()) {
-        processBroadcast(packet);
+        processBroadcast(packet, vid);
     } else if (macTag->getDestAddress().isMulticast()) {
-        processMulticast(packet);
+        processMulticast(packet, vid);
     } else {
-        processUnicast(packet);
+        processUnicast(packet, vid);
     }
 }
 
-void ForwardingRelayUnit::processBroadcast(Packet* packet) {
-    // Flood packets everywhere except of ingress port
-    // TODO this is just a temporary solution not sure how correct that is
-    for (int portId = 0; portId < gateSize("out"); portId++) {
-        cGate *outputGate = gate("out", portId);
-        if (!packet->arrivedOn("in", portId)) {
-            Packet* dupPacket = packet->dup();
-            send(dupPacket, outputGate);
+int ForwardingRelayUnit::getArrivalPort(Packet* packet) {
+    return packet->arrivedOn("in") ? packet->getArrivalGate()->getIndex() : -1;
+}
+
+cGate* ForwardingRelayUnit::getOutGate(int portId) {
+    if (portId >= numberOfPorts) {
+        throw cRuntimeError("Forwarding to port %d, but the switch has only "
+                "%d ports.", portId, numberOfPorts);
+    }
+    return outGates[portId];
+}
+
+int ForwardingRelayUnit::getVid(Packet* packet) {
+    auto vlanTag = packet->findTag<VLANTagInd>();
+    return vlanTag ? vlanTag->getVID() : 0;
+}
+
+void ForwardingRelayUnit::fanOut(Packet* packet, const PortSet* ports) {
+    int arrivalPort = getArrivalPort(packet);
+    int lastPort = -1;
+    // Every port but the last one gets a copy, which shares the immutable
+    // data chunks of the packet
+    auto forward = [this, packet, arrivalPort, &lastPort](int portId) {
+        if (portId == arrivalPort) {
+            return;
+        }
+        if (lastPort >= 0) {
+            send(packet->dup(), getOutGate(lastPort));
+            numPacketCopies++;
+        }
+        lastPort = portId;
+    };
+    if (ports == nullptr) {
+        for (int portId = 0; portId < numberOfPorts; portId++) {
+            forward(portId);
         }
+    } else {
+        ports->forEach(forward);
+    }
+    if (lastPort >= 0) {
+        send(packet, getOutGate(lastPort));
+    } else {
+        delete packet;
     }
-    delete packet;
 }
 
-void ForwardingRelayUnit::processMulticast(Packet* packet) {
+void ForwardingRelayUnit::processBroadcast(Packet* packet, int vid) {
+    // Flood packets to all member ports of the VLAN except of ingress port
+    // TODO this is just a temporary solution not sure how correct that is
+    fanOut(packet, fdb->getVlanMembers(vid));
+}
+
+void ForwardingRelayUnit::processMulticast(Packet* packet, int vid) {
     auto macTag = packet->getTag<MacAddressInd>();
-    int arrivalGate = packet->getArrivalGate()->getIndex();
 
-    std::vector<int> forwardingPorts = fdb->getPorts(macTag->getDestAddress(),
-            simTime());
+    const PortSet* forwardingPorts = fdb->getPorts(macTag->getDestAddress(),
+            vid, simTime());
 
-    if (forwardingPorts.at(0) == -1) {
+    if (forwardingPorts == nullptr) {
         throw cRuntimeError(
                 "Static multicast forwarding for packet didn't work. Entry in forwarding table was empty!");
-    } else {
-        std::string forwardingPortsString = "";
-        for (auto forwardingPort : forwardingPorts) {
-            // skip arrival gate
-            if (forwardingPort == arrivalGate) {
-                continue;
-            }
-            Packet* dupPacket = packet->dup();
-            send(dupPacket, gate("out", forwardingPort));
-            forwardingPortsString = forwardingPortsString.append(
-                    std::to_string(forwardingPort));
-        }
-        EV_INFO << getFullPath() << ": Forwarding multicast packet `" << packet
-                       << "` to ports " << forwardingPortsString << endl;
     }
-    delete packet;
+    EV_INFO << getFullPath() << ": Forwarding multicast packet `" << packet
+                   << "` to ports " << forwardingPorts->str()
+                   << " except of ingress port" << endl;
+    fanOut(packet, forwardingPorts);
 }
 
-void ForwardingRelayUnit::processUnicast(Packet* packet) {
+void ForwardingRelayUnit::processUnicast(Packet* packet, int vid) {
     // Control info is needed to retrieve destination MAC address
     auto macTag = packet->getTag<MacAddressInd>();
 
     //Learning MAC port mappings
-    fdb->insert(macTag->getSrcAddress(), simTime(),
+    fdb->insert(macTag->getSrcAddress(), vid, simTime(),
             packet->getArrivalGate()->getIndex());
-    int forwardingPort = fdb->getPort(macTag->getDestAddress(), simTime());
+    int forwardingPort = fdb->getPort(macTag->getDestAddress(), vid,
+            simTime());
 
-    Packet* dupPacket;
     //Routing entry available?
     if (forwardingPort == -1) {
-        dupPacket = packet->dup();
-        processBroadcast(dupPacket);
         EV_INFO << getFullPath() << ": Broadcasting packets `" << packet
                        << "` to all ports" << endl;
+        processBroadcast(packet, vid);
     } else {
-        dupPacket = packet->dup();
+        // The packet itself is forwarded, no copy is needed
         EV_INFO << getFullPath() << ": Forwarding packet `" << packet
                        << "` to port " << forwardingPort << endl;
-        send(dupPacket, gate("out", forwardingPort));
+        send(packet, getOutGate(forwardingPort));
     }
+}
 
-    delete packet;
+void ForwardingRelayUnit::finish() {
+    recordScalar("packetCopies", numPacketCopies);
 }
 
 } // namespace nesting
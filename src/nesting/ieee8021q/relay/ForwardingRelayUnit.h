@@ -17,11 +17,13 @@
 #define __MAIN_FORWARDINGRELAYUNIT_H_
 
 #include <unordered_map>
+#include <vector>
 #include <omnetpp.h>
 
 #include "inet/common/ModuleAccess.h"
 #include "inet/common/packet/Packet.h"
 #include "inet/linklayer/common/MacAddressTag_m.h"
+#include "../../linklayer/common/VLANTag_m.h"
 #include "FilteringDatabase.h"
 
 using namespace omnetpp;
@@ -36,14 +38,43 @@ class ForwardingRelayUnit: public cSimpleModule {
 private:
     FilteringDatabase* fdb;
     int numberOfPorts;
+
+    /** Output gate per port, looked up once instead of by name per frame. */
+    std::vector<cGate*> outGates;
+
+    /** Number of packet copies made for flooding and multicast. */
+    long numPacketCopies = 0;
     //TODO: Create parameter for filtering database aging
     simtime_t fdbAgingThreshold = 1000;
 protected:
     virtual void initialize();
     virtual void handleMessage(cMessage* msg);
-    virtual void processBroadcast(Packet* packet);
-    virtual void processMulticast(Packet* packet);
-    virtual void processUnicast(Packet* packet);
+    virtual void finish() override;
+    /**
+     * Returns the VID of a received frame, or 0 if it carries no VLAN tag.
+     */
+    virtual int getVid(Packet* packet);
+
+    /**
+     * Returns the port a frame was received on, or -1 if it was not received
+     * on a port.
+     */
+    virtual int getArrivalPort(Packet* packet);
+
+    /** Returns the output gate of a port, which has to exist. */
+    virtual cGate* getOutGate(int portId);
+
+    /**
+     * Sends a packet to the given ports except of its ingress port, or to all
+     * ports if ports is nullptr. The last port gets the packet itself, the
+     * others copies. The packet is deleted if no port is left.
+     */
+    virtual void fanOut(Packet* packet, const PortSet* ports);
+
+    /** Floods a frame to the member ports of its VLAN. */
+    virtual void processBroadcast(Packet* packet, int vid);
+    virtual void processMulticast(Packet* packet, int vid);
+    virtual void processUnicast(Packet* packet, int vid);
 
 public:
     //TODO: Fix filtering database aging parameter!
@@ -0,0 +1,43 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "EncapsulatedFrame.h"
+
+#include "inet/common/ProtocolTag_m.h"
+
+namespace nesting {
+
+EncapsulatedFrame::EncapsulatedFrame(inet::Packet* encapsulatedFrame,
+        uint64_t id) :
+        id(id), name(encapsulatedFrame->getName()), protocol(nullptr), content(
+                encapsulatedFrame->peekAll()), byteLength(
+                encapsulatedFrame->getByteLength()) {
+    auto protocolTag = encapsulatedFrame->findTag<inet::PacketProtocolTag>();
+    if (protocolTag != nullptr) {
+        protocol = protocolTag->getProtocol();
+    }
+}
+
+inet::EthernetSignal* EncapsulatedFrame::createSignal() const {
+    inet::Packet* frame = new inet::Packet(name.c_str(), content);
+    if (protocol != nullptr) {
+        frame->addTag<inet::PacketProtocolTag>()->setProtocol(protocol);
+    }
+    inet::EthernetSignal* signal = new inet::EthernetSignal(name.c_str());
+    signal->encapsulate(frame);
+    return signal;
+}
+
+} /* namespace nesting */
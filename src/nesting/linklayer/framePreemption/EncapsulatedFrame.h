@@ -0,0 +1,85 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef NESTING_LINKLAYER_FRAMEPREEMPTION_ENCAPSULATEDFRAME_H_
+#define NESTING_LINKLAYER_FRAMEPREEMPTION_ENCAPSULATEDFRAME_H_
+
+#include <omnetpp.h>
+#include <memory>
+#include <string>
+
+#include "inet/common/Protocol.h"
+#include "inet/common/packet/Packet.h"
+#include "inet/linklayer/ethernet/EtherPhyFrame_m.h"
+
+using namespace omnetpp;
+
+namespace nesting {
+
+/**
+ * Immutable image of a preemptable frame as it is put on the wire, i.e.
+ * including preamble and SFD. All fragments of the frame refer to the same
+ * image, which is created once when the transmission of the frame starts.
+ * The frame data is held as an INET chunk, which is immutable and shared, so
+ * the receiver can rebuild the frame without copying its data.
+ */
+class EncapsulatedFrame {
+protected:
+    /** Identifier of the frame, unique within the simulation. */
+    uint64_t id;
+
+    std::string name;
+
+    /** Protocol of the encapsulated frame, usually ethernetPhy. */
+    const inet::Protocol* protocol;
+
+    /** Frame data including the physical header. */
+    inet::Ptr<const inet::Chunk> content;
+
+    int64_t byteLength;
+
+public:
+    /**
+     * Creates the image of an encapsulated frame. The frame is not taken
+     * over and can be deleted afterwards.
+     */
+    EncapsulatedFrame(inet::Packet* encapsulatedFrame, uint64_t id);
+
+    uint64_t getId() const {
+        return id;
+    }
+
+    const char* getName() const {
+        return name.c_str();
+    }
+
+    /** Length of the frame including preamble and SFD. */
+    int64_t getByteLength() const {
+        return byteLength;
+    }
+
+    /**
+     * Creates the signal the frame would have been sent in without
+     * preemption. The frame data is shared with this image.
+     */
+    inet::EthernetSignal* createSignal() const;
+};
+
+/** Reference counted handle to an encapsulated frame. */
+typedef std::shared_ptr<const EncapsulatedFrame> EncapsulatedFramePtr;
+
+} /* namespace nesting */
+
+#endif /* NESTING_LINKLAYER_FRAMEPREEMPTION_ENCAPSULATEDFRAME_H_ */
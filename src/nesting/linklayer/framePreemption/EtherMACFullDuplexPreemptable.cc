@@ -15,6 +15,8 @@
 
 #include "EtherMACFullDuplexPreemptable.h"
 
+#include <algorithm>
+
 #include "inet/common/queue/IPassiveQueue.h"
 // #include "inet/common/NotifierConsts.h"
 #include "inet/networklayer/common/InterfaceEntry.h"
@@ -52,10 +54,15 @@ simsignal_t EtherMACFullDuplexPreemptable::receivedPreemptableFrameFull =
 EtherMACFullDuplexPreemptable::~EtherMACFullDuplexPreemptable() {
     cancelAndDelete(recheckForQueuedExpressFrameMsg);
     cancelAndDelete(preemptCurrentFrameMsg);
+    for (cMessage* msg : holdRequestPool) {
+        delete msg;
+    }
 
-    delete receivedPreemptedFrame;
     delete currentPreemptableFrame;
     delete currentExpressFrame;
+    for (Packet* packet : burstFrames) {
+        delete packet;
+    }
 }
 
 void EtherMACFullDuplexPreemptable::initialize(int stage) {
@@ -65,7 +72,42 @@ void EtherMACFullDuplexPreemptable::initialize(int stage) {
         transmissionSelectionModule = getModuleFromPar<TransmissionSelection>(
                 par("queueModule"), this);
         transmissionSelectionModule->addListener(this);
-        preemptCurrentFrameMsg = new cMessage("preemptCurrentFrame");
+        preemptCurrentFrameMsg = new cMessage("preemptCurrentFrame",
+                kPreemptCurrentFrame);
+        recheckForQueuedExpressFrameMsg = new cMessage(
+                "recheckForQueuedExpressFrame", kRecheckForQueuedExpressFrame);
+
+        int addFragSize = par("addFragSize");
+        if (addFragSize < 0 || addFragSize > 3) {
+            throw cRuntimeError("addFragSize must be in the range 0 to 3.");
+        }
+        minNonFinalPayloadBytes = framePreemptionMinNonFinalPayloadSize(
+                addFragSize).get();
+        // Hold and release requests are only served with frame preemption
+        singleEventTransmission = par("singleEventTransmission")
+                && !par("enablePreemptingFrames");
+        if (singleEventTransmission) {
+            // The next frame is selected in this event, so it has to come
+            // after the gate and queue events of the same time like the
+            // request events of the transmission selection
+            endTxMsg->setSchedulingPriority(selfMessageSchedulingPriority);
+        }
+        // Bursts of express frames would bypass the preemption rules
+        maxBurstSize = par("enablePreemptingFrames") ? 1 : par("maxBurstSize");
+        if (maxBurstSize < 1) {
+            throw cRuntimeError("maxBurstSize must be at least 1.");
+        }
+
+        fragmentsPerFrameHistogram.setName("fragmentsPerFrame");
+        expressWaitHistogram.setName("expressPreemptionWait");
+        holdDurationHistogram.setName("holdDuration");
+        holdIdleHistogram.setName("holdIdleTime");
+
+        WATCH(numFramesReassembled);
+        WATCH(numReassemblyErrors);
+        WATCH(numPreemptionOverheadBytes);
+        WATCH(numExpressWaitsForTail);
+        WATCH(totalHoldIdleTime);
     }
 }
 
@@ -92,27 +134,8 @@ void EtherMACFullDuplexPreemptable::handleMessageWhenUp(cMessage *msg) {
             processMsgFromNetwork(tmp);
         }
         // is preemptible frame
-        else if (dynamic_cast<EthernetSignal*>(pFrame->getCompleteFrame())) {
-            // if incoming frame is new frame, replace old preempted frame by new one
-            if (receivedPreemptedFrame == nullptr
-                    || strcmp(receivedPreemptedFrame->getName(),
-                            pFrame->getCompleteFrame()->getName()) != 0) {
-                delete receivedPreemptedFrame;
-                receivedPreemptedFrame = pFrame->getCompleteFrame()->dup();
-            }
-
-            preemptedBytesReceived = pFrame->getBytesSent();
-            //8 extra bytes for encapsulation with Preamble and SFD
-            if (receivedPreemptedFrame->getByteLength()
-                    == preemptedBytesReceived + 8) {
-                //enough bytes from the preempted frame received -> send it up
-                EthernetSignal* tmp = check_and_cast<EthernetSignal*>(
-                        receivedPreemptedFrame);
-                emit(receivedPreemptableFrameFull, tmp);
-                processMsgFromNetwork(tmp);
-                receivedPreemptedFrame = nullptr;
-            }
-            delete pFrame;
+        else if (pFrame->getFrame()) {
+            handlePreemptedFrame(pFrame);
         } else
         // unknown packet
         {
@@ -123,6 +146,65 @@ void EtherMACFullDuplexPreemptable::handleMessageWhenUp(cMessage *msg) {
     }
 }
 
+void EtherMACFullDuplexPreemptable::handlePreemptedFrame(
+        PreemptedFrame* fragment) {
+    const FrameHandle& frame = fragment->getFrame();
+    if (fragment->getFragmentOffset() == 0) {
+        // first fragment of a new frame
+        if (reassembly.frame) {
+            EV_WARN << getFullPath() << ": Final fragment of frame "
+                           << reassembly.frame->getName()
+                           << " missing, discarding frame." << endl;
+            numReassemblyErrors++;
+        }
+        reassembly.frame = frame;
+        reassembly.bytesReceived = 0;
+        reassembly.nextFragmentCount = 0;
+    } else if (!reassembly.frame || reassembly.frame->getId() != frame->getId()) {
+        EV_WARN << getFullPath() << ": First fragment of frame "
+                       << frame->getName() << " missing, discarding fragment."
+                       << endl;
+        numReassemblyErrors++;
+        delete fragment;
+        return;
+    }
+
+    if (fragment->getFragmentCount() != reassembly.nextFragmentCount
+            || fragment->getFragmentOffset() != reassembly.bytesReceived) {
+        EV_WARN << getFullPath() << ": Fragment " << fragment
+                       << " lost or out of order, discarding frame." << endl;
+        numReassemblyErrors++;
+        reassembly.frame = nullptr;
+        delete fragment;
+        return;
+    }
+    reassembly.bytesReceived += fragment->getFragmentLength();
+    reassembly.nextFragmentCount = (reassembly.nextFragmentCount + 1) % 4;
+
+    if (fragment->getFinalFragment()) {
+        //all bytes of the preempted frame received -> send it up
+        EthernetSignal* signal = reassembly.frame->createSignal();
+        reassembly.frame = nullptr;
+        numFramesReassembled++;
+        emit(receivedPreemptableFrameFull, signal);
+        processMsgFromNetwork(signal);
+    }
+    delete fragment;
+}
+
+void EtherMACFullDuplexPreemptable::finish() {
+    EtherMacFullDuplex::finish();
+    recordScalar("framesReassembled", numFramesReassembled);
+    recordScalar("reassemblyErrors", numReassemblyErrors);
+    recordScalar("preemptionOverheadBytes", numPreemptionOverheadBytes, "B");
+    recordScalar("expressWaitsForTail", numExpressWaitsForTail);
+    recordScalar("holdIdleTime", totalHoldIdleTime, "s");
+    fragmentsPerFrameHistogram.record();
+    expressWaitHistogram.record();
+    holdDurationHistogram.record();
+    holdIdleHistogram.record();
+}
+
 void EtherMACFullDuplexPreemptable::handleSelfMessage(cMessage *msg) {
     EV_TRACE << "Self-message " << msg << " received" << endl;
     if (msg == endTxMsg)
@@ -131,15 +213,21 @@ void EtherMACFullDuplexPreemptable::handleSelfMessage(cMessage *msg) {
         handleEndIFGPeriod();
     else if (msg == endPauseMsg)
         handleEndPausePeriod();
-    else if (strcmp(msg->getName(), "recheckForQueuedExpressFrame") == 0)
-        checkForAndRequestExpressFrame();
-    else if (msg == preemptCurrentFrameMsg)
-        preemptCurrentFrame();
-    else if (strcmp(msg->getName(), "holdRequest") == 0) {
-        hold(SIMTIME_ZERO);
-        delete msg;
-    } else {
-        throw cRuntimeError("Unknown self message received!");
+    else {
+        switch (msg->getKind()) {
+        case kRecheckForQueuedExpressFrame:
+            checkForAndRequestExpressFrame();
+            break;
+        case kPreemptCurrentFrame:
+            preemptCurrentFrame();
+            break;
+        case kHoldRequest:
+            holdRequestPool.push_back(msg);
+            hold(SIMTIME_ZERO);
+            break;
+        default:
+            throw cRuntimeError("Unknown self message received!");
+        }
     }
 }
 
@@ -200,9 +288,22 @@ void EtherMACFullDuplexPreemptable::handleUpperPacket(Packet* packet) {
         EtherEncap::addFcs(packet, oldFcs->getFcsMode());
     }
     //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~INET/END~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-    if (isExpressFrame && recheckForQueuedExpressFrameMsg != nullptr
-            && recheckForQueuedExpressFrameMsg->isScheduled()) {
-        cancelAndDelete(recheckForQueuedExpressFrameMsg);
+    // Padding and FCS are final from here on, so neither express nor
+    // preemptable transmissions have to touch the frame content again
+    if (packet->getDataLength() < curEtherDescr->frameMinBytes) {
+        auto oldFcs = packet->removeAtBack<EthernetFcs>();
+        EtherEncap::addPaddingAndFcs(packet, oldFcs->getFcsMode(),
+                curEtherDescr->frameMinBytes);
+    }
+    if (maxBurstSize > 1
+            && (transmitState != TX_IDLE_STATE || curTxFrame
+                    || !burstFrames.empty())) {
+        // Further frame of a burst, transmitted after the pending ones
+        burstFrames.push_back(packet);
+        return;
+    }
+    if (isExpressFrame) {
+        cancelEvent(recheckForQueuedExpressFrameMsg);
     }
     bool nowPreempting = false;
     // currently not transmitting express frame and this frame is express or preemptible frame
@@ -255,40 +356,35 @@ void EtherMACFullDuplexPreemptable::handleUpperPacket(Packet* packet) {
 
 void EtherMACFullDuplexPreemptable::startFrameTransmission() {
     Enter_Method_Silent("startFrameTransmission()");
-    //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~INET/BEGIN~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     ASSERT(curTxFrame);
-    EV_DETAIL << "Transmitting a copy of frame " << curTxFrame << endl;
-
-    bool isExpressFrame = !(curTxFrame->arrivedOn("upperLayerPreemptableIn"));
-    Packet *frame = curTxFrame->dup();// note: we need to duplicate the frame because we emit a signal with it in endTxPeriod()
-    const auto& hdr = frame->peekAtFront<EthernetMacHeader>();// note: we need to duplicate the frame because we emit a signal with it in endTxPeriod()
-    ASSERT(hdr);
-    ASSERT(!hdr->getSrc().isUnspecified());
-
-    if (frame->getDataLength() < curEtherDescr->frameMinBytes) {
-        auto oldFcs = frame->removeAtBack<EthernetFcs>();
-        EtherEncap::addPaddingAndFcs(frame, oldFcs->getFcsMode(), curEtherDescr->frameMinBytes);
-    }
-    //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~INET/END~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     ASSERT(!transmittingExpressFrame);
     ASSERT(!transmittingPreemptableFrame);
-    EV_INFO << getFullPath() << " at t=" << simTime().inUnit(SIMTIME_NS) << "ns:" << " Starting Transmission of " << frame << ". Express: " << isExpressFrame << endl;
+
+    bool isExpressFrame = !continuingPreemptableFrame
+            && !(curTxFrame->arrivedOn("upperLayerPreemptableIn"));
+    EV_INFO << getFullPath() << " at t=" << simTime().inUnit(SIMTIME_NS) << "ns:" << " Starting Transmission of " << curTxFrame << ". Express: " << isExpressFrame << endl;
 
     //If frame preemption is disabled, treat all frames as express so they are properly displayed
     if (!par("enablePreemptingFrames") || isExpressFrame) {
+        // The frame itself is handed over to the channel, statistics are
+        // recorded before that instead of in handleEndTxPeriod()
+        Packet *frame = curTxFrame;
+        curTxFrame = nullptr;
+        ASSERT(!frame->peekAtFront<EthernetMacHeader>()->getSrc().isUnspecified());
+        recordExpressFrameSent(frame);
         //Send frame out normally
         transmittingExpressFrame = true;
+        updateHoldIdleState();
         //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~INET/BEGIN~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
         // add preamble and SFD (Starting Frame Delimiter), then send out
         encapsulate(frame);
 
         // send
         EV_INFO << "Transmission of " << frame << " started.\n";
-        auto oldPacketProtocolTag = frame->removeTag<PacketProtocolTag>();
+        auto packetProtocolTag = frame->removeTag<PacketProtocolTag>();
         frame->clearTags();
-        auto newPacketProtocolTag = frame->addTag<PacketProtocolTag>();
-        *newPacketProtocolTag = *oldPacketProtocolTag;
-        delete oldPacketProtocolTag;
+        *frame->addTag<PacketProtocolTag>() = *packetProtocolTag;
+        delete packetProtocolTag;
         auto signal = new EthernetSignal(frame->getName());
         if (sendRawBytes) {
             signal->encapsulate(new Packet(frame->getName(), frame->peekAllAsBytes()));
@@ -299,38 +395,65 @@ void EtherMACFullDuplexPreemptable::startFrameTransmission() {
         }
         send(signal, physOutGate);
         emit(eMacDelay, simTime() - eFrameArrivalTime);
-        scheduleAt(transmissionChannel->getTransmissionFinishTime(), endTxMsg);
+        simtime_t endTxTime = transmissionChannel->getTransmissionFinishTime();
+        if (singleEventTransmission) {
+            endTxTime += interframeGapDuration();
+        }
+        scheduleAt(endTxTime, endTxMsg);
         //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~INET/END~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     } else {
         // "Sending" preemptable frame
         // (block the link for the theoretical type and send zero-time frame later, indicating how many bytes were transferred)
-        // Check if it is a new preemptable frame
-        if (currentPreemptableFrame == nullptr || strcmp(currentPreemptableFrame->getName(), curTxFrame->getName())!=0) {
-            // new frame, reset number of bytes sent
-            preemptedBytesSent = 0;
+        if (!continuingPreemptableFrame) {
+            // New frame from the queue. The MAC keeps it until its final
+            // fragment is sent, curTxFrame is deleted after every link
+            // transmission and therefore only stands for it.
             delete currentPreemptableFrame;
-            // curTxFrame is deleted after every link transmission -> duplicate frame
-            currentPreemptableFrame = curTxFrame->dup();
+            currentPreemptableFrame = curTxFrame;
+            currentPreemptableImage = nullptr;
+            curTxFrame = createPreemptableFramePlaceholder();
+        }
+        continuingPreemptableFrame = false;
+        if (!currentPreemptableImage) {
+            // first fragment, reset number of bytes sent
+            preemptedBytesSent = 0;
+            fragmentCount = 0;
+            numFragmentsSent = 0;
+            currentPreemptableImage = createPreemptableImage();
         }
 
         transmittingPreemptableFrame = true;
+        updateHoldIdleState();
+        expressWaitRecorded = false;
         preemptableTransmissionStart = simTime();
-        // add preamble and SFD (Starting Frame Delimiter)
-        encapsulate(frame);
+        computePreemptionWindow();
 
-        //Calculate number of bytes to theoretically send, including Preamble, SMD and FCS
-        unsigned int preemptedPacketLength = frame->getByteLength() - preemptedBytesSent;
-        cPacket* frameCopyToCalculateLength = new cPacket();
-        frameCopyToCalculateLength->setByteLength(preemptedPacketLength);
-        //Block link for the theoretically needed amount of time
-        scheduleAt(simTime() + transmissionChannel->calculateDuration(frameCopyToCalculateLength), endTxMsg);
+        //Block link for the theoretically needed amount of time to send the
+        //remaining bytes, including Preamble, SMD and FCS
+        unsigned int preemptedPacketLength =
+                currentPreemptableImage->getByteLength() - preemptedBytesSent;
+        scheduleAt(simTime() + calculateTransmissionDuration(preemptedPacketLength), endTxMsg);
         emit(pMacDelay, simTime() - pFrameArrivalTime);
-        delete frame;
-        delete frameCopyToCalculateLength;
     }
     changeTransmissionState(TRANSMITTING_STATE);
 }
 
+Packet* EtherMACFullDuplexPreemptable::createPreemptableFramePlaceholder() {
+    return new Packet(currentPreemptableFrame->getName(),
+            currentPreemptableFrame->peekAll());
+}
+
+EncapsulatedFramePtr EtherMACFullDuplexPreemptable::createPreemptableImage() {
+    // padding was already added in handleUpperPacket()
+    Packet* frame = createPreemptableFramePlaceholder();
+    // add preamble and SFD (Starting Frame Delimiter)
+    encapsulate(frame);
+    EncapsulatedFramePtr image = std::make_shared<const EncapsulatedFrame>(
+            frame, currentPreemptableFrame->getId());
+    delete frame;
+    return image;
+}
+
 void EtherMACFullDuplexPreemptable::getNextFrameFromQueue() {
 
     ASSERT(nullptr == curTxFrame);
@@ -349,11 +472,26 @@ void EtherMACFullDuplexPreemptable::getNextFrameFromQueue() {
         //If there is a started preemptable frame, continue it
     } else if (!onHold && currentPreemptableFrame) {
         //Otherwise continue started preemptable frame if it existed
-        curTxFrame = currentPreemptableFrame->dup();
+        curTxFrame = createPreemptableFramePlaceholder();
+        continuingPreemptableFrame = true;
         EV_DETAIL << getFullPath() << " at t=" << simTime().inUnit(SIMTIME_NS)
                          << "ns:" << " Getting preempted frame " << curTxFrame
                          << " instead of one from the queue." << endl;
+        //Then frames of a burst that are already here
+    } else if (!burstFrames.empty()) {
+        curTxFrame = burstFrames.front();
+        burstFrames.pop_front();
         //Otherwise ask queues like in the superclass
+    } else if (txQueue.extQueue && maxBurstSize > 1) {
+        if (transmissionSelectionModule->getNumPendingRequests() == 0) {
+            transmissionSelectionModule->requestPackets(maxBurstSize);
+        }
+        //Or let the transmission selection send the next frame right away
+    } else if (txQueue.extQueue && singleEventTransmission) {
+        if (transmissionSelectionModule->getNumPendingRequests() == 0
+                && !transmissionSelectionModule->sendPacket()) {
+            requestNextFrameFromExtQueue();
+        }
     } else if (txQueue.extQueue) {
         requestNextFrameFromExtQueue();
     } else if (txQueue.innerQueue && !txQueue.innerQueue->isEmpty()) {
@@ -368,6 +506,7 @@ void EtherMACFullDuplexPreemptable::handleEndTxPeriod() {
         // A (part of a) preemptable frame was sent
         emit(transmittedPreemptableFramePartSignal, currentPreemptableFrame);
         bool beginningOfPreemptableFrame = (preemptedBytesSent == 0);
+        unsigned int fragmentOffset = preemptedBytesSent;
         // Update bytes sent so far for this preemptable frame
         unsigned int bytesSentInThisPart =
                 (unsigned int) calculatePreemptedPayloadBytesSent(simTime(),
@@ -406,51 +545,90 @@ void EtherMACFullDuplexPreemptable::handleEndTxPeriod() {
                        << preemptedBytesSent << "/"
                        << currentPreemptableFrame->getByteLength() << "B"
                        << endl;
-        // dup frame to create new zero msg
-        Packet* currentPreemptableFrameCopy = currentPreemptableFrame->dup();
-        // encapsulate frame properly, so that receiver mac can decapsulate
-        encapsulate(currentPreemptableFrameCopy);
-        auto oldPacketProtocolTag = currentPreemptableFrameCopy->removeTag<
-                PacketProtocolTag>();
-        currentPreemptableFrameCopy->clearTags();
-        auto newPacketProtocolTag = currentPreemptableFrameCopy->addTag<
-                PacketProtocolTag>();
-        *newPacketProtocolTag = *oldPacketProtocolTag;
-        delete oldPacketProtocolTag;
-        auto signalCurrentPreemptableFrameCopy = new EthernetSignal(
-                currentPreemptableFrameCopy->getName());
-        signalCurrentPreemptableFrameCopy->encapsulate(
-                currentPreemptableFrameCopy);
+        // zero-length fragment referring to the shared image of the frame
         PreemptedFrame* preemptedBytesSentMessage = new PreemptedFrame(
-                signalCurrentPreemptableFrameCopy);
-        // can't be deleted because reference is kept by PreemptedFrame msg
-        // delete currentPreemptableFrameCopy;
-        // bytes sent up until now
-        preemptedBytesSentMessage->setBytesSent(preemptedBytesSent);
-        // bytes to be sent in total
-        preemptedBytesSentMessage->setBytesTotal(
-                currentPreemptableFrame->getByteLength());
-        // bytes sent in this framelet
-        preemptedBytesSentMessage->setBytesInThisPart(bytesSentInThisPart);
+                currentPreemptableImage);
+        bool finalFragment = preemptedBytesSent
+                == currentPreemptableFrame->getByteLength();
+        preemptedBytesSentMessage->setFragmentOffset(fragmentOffset);
+        preemptedBytesSentMessage->setFragmentLength(bytesSentInThisPart);
+        preemptedBytesSentMessage->setFinalFragment(finalFragment);
+        preemptedBytesSentMessage->setFragmentCount(fragmentCount);
+        fragmentCount = (fragmentCount + 1) % 4;
+        numFragmentsSent++;
         // set length to zero to not have transmission delay
         preemptedBytesSentMessage->setByteLength(0);
         send(preemptedBytesSentMessage, physOutGate);
 
         //If this was the final part of a preemptable frame, delete it
-        if (preemptedBytesSent == currentPreemptableFrame->getByteLength()) {
+        if (finalFragment) {
+            fragmentsPerFrameHistogram.collect(numFragmentsSent);
+            // Every further fragment has its own preamble and SMD, and the
+            // fragment before it ends with an mCRC
+            numPreemptionOverheadBytes += (numFragmentsSent - 1)
+                    * ((PREAMBLE_BYTES + SFD_BYTES).get() + 4);
             delete currentPreemptableFrame;
             currentPreemptableFrame = nullptr;
+            currentPreemptableImage = nullptr;
         }
-    } else {
-        EV_DETAIL << getFullPath() << " at t=" << simTime().inUnit(SIMTIME_NS)
-                         << "ns:" << " Express Frame " << curTxFrame
-                         << " finished to transmit." << endl;
-        //Can only be express frame, as it is the default if frame preemption is disabled
-        emit(transmittedExpressFrameSignal, curTxFrame);
+        transmittingPreemptableFrame = false;
+        updateHoldIdleState();
+        EtherMacFullDuplex::handleEndTxPeriod();
+        return;
     }
+    //Can only be express frame, as it is the default if frame preemption is disabled
+    //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~INET/BEGIN~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    if (transmitState != TRANSMITTING_STATE)
+        throw cRuntimeError("End of transmission, and incorrect state detected");
+    //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~INET/END~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    EV_DETAIL << getFullPath() << " at t=" << simTime().inUnit(SIMTIME_NS)
+                     << "ns:" << " Express frame finished to transmit." << endl;
     transmittingExpressFrame = false;
-    transmittingPreemptableFrame = false;
-    EtherMacFullDuplex::handleEndTxPeriod();
+    updateHoldIdleState();
+    lastTxFinishTime = simTime();
+    if (singleEventTransmission) {
+        // endTxMsg was scheduled for the end of the interframe gap, so the
+        // next frame can be requested and started right away
+        lastTxFinishTime -= interframeGapDuration();
+        if (pauseUnitsRequested == 0) {
+            changeTransmissionState(WAIT_IFG_STATE);
+            handleEndIFGPeriod();
+            return;
+        }
+    }
+    //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~INET/BEGIN~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    getNextFrameFromQueue();
+
+    if (pauseUnitsRequested > 0) {
+        // if we received a PAUSE frame recently, go into PAUSE state
+        EV_DETAIL << "Going to PAUSE mode for " << pauseUnitsRequested << " time units\n";
+        scheduleEndPausePeriod(pauseUnitsRequested);
+        pauseUnitsRequested = 0;
+    }
+    else {
+        EV_DETAIL << "Start IFG period\n";
+        scheduleEndIFGPeriod();
+    }
+    //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~INET/END~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+}
+
+void EtherMACFullDuplexPreemptable::recordExpressFrameSent(Packet* frame) {
+    //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~INET/BEGIN~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    numFramesSent++;
+    numBytesSent += frame->getByteLength();
+    emit(packetSentToLowerSignal, frame);
+
+    const auto& header = frame->peekAtFront<EthernetMacHeader>();
+    if (header->getTypeOrLength() == ETHERTYPE_FLOW_CONTROL) {
+        const auto& controlFrame = frame->peekDataAt<EthernetControlFrame>(header->getChunkLength(), b(-1));
+        if (controlFrame->getOpCode() == ETHERNET_CONTROL_PAUSE) {
+            const auto& pauseFrame = CHK(dynamicPtrCast<const EthernetPauseFrame>(controlFrame));
+            numPauseFramesSent++;
+            emit(txPausePkUnitsSignal, pauseFrame->getPauseTime());
+        }
+    }
+    //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~INET/END~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    emit(transmittedExpressFrameSignal, frame);
 }
 
 void EtherMACFullDuplexPreemptable::handleEndIFGPeriod() {
@@ -531,25 +709,34 @@ int EtherMACFullDuplexPreemptable::calculatePreemptedPayloadBytesSent(
     return bytesTransmittedInTotal;
 }
 
+void EtherMACFullDuplexPreemptable::computePreemptionWindow() {
+    int bytesRemaining = currentPreemptableFrame->getByteLength()
+            - preemptedBytesSent;
+    // Most bytes that may be sent before preempting, so that the final
+    // fragment is large enough
+    int maxBytesSent = bytesRemaining
+            - kFramePreemptionMinFinalPayloadSize.get();
+    preemptionWindowStart = simTime();
+    preemptionWindowEnd = simTime();
+    if (maxBytesSent >= minNonFinalPayloadBytes) {
+        preemptionWindowStart += calculateTransmissionDuration(
+                minNonFinalPayloadBytes);
+        preemptionWindowEnd += calculateTransmissionDuration(maxBytesSent + 1);
+    }
+    // Waiting for the window also needs room for the 4B checksum of the
+    // non-final fragment
+    preemptionLaterPossible = bytesRemaining
+            >= minNonFinalPayloadBytes + 4
+                    + kFramePreemptionMinFinalPayloadSize.get();
+}
+
 simtime_t EtherMACFullDuplexPreemptable::isPreemptionLaterPossible() {
 
     if (isPreemptionNowPossible()) {
         return simTime();
-    }
-    int payloadBytesSentByNow = calculatePreemptedPayloadBytesSent(simTime(),
-            false);
-    int payloadBytesRemaining = currentPreemptableFrame->getByteLength()
-            - payloadBytesSentByNow - preemptedBytesSent;
-    // TODO Why payloadBytesRemaining >= NonFinal + - sentbynow + FinalPayloadSize??
-    if (payloadBytesSentByNow < kFramePreemptionMinNonFinalPayloadSize.get()
-            && payloadBytesRemaining
-                    >= kFramePreemptionMinNonFinalPayloadSize.get() + 4
-                            - payloadBytesSentByNow
-                            + kFramePreemptionMinFinalPayloadSize.get()) {
+    } else if (preemptionLaterPossible && simTime() < preemptionWindowStart) {
         //Preemption not yet possible, but after a short time -> Need to wait to preempt
-        int bytesToWait = (kFramePreemptionMinNonFinalPayloadSize.get()
-                - payloadBytesSentByNow);
-        return simTime() + calculateTransmissionDuration(bytesToWait);
+        return preemptionWindowStart;
     }
     //Too late to preempt this frame at all
     return SIMTIME_ZERO;
@@ -563,19 +750,9 @@ bool EtherMACFullDuplexPreemptable::isPreemptionNowPossible() {
     } else if (transmittingExpressFrame) {
         return false;
     }
-    int payloadBytesSent = calculatePreemptedPayloadBytesSent(simTime(), false);
-    int payloadBytesRemaining = currentPreemptableFrame->getByteLength()
-            - payloadBytesSent - preemptedBytesSent;
-    if (payloadBytesRemaining < kFramePreemptionMinFinalPayloadSize.get()) {
-        //Final fragment size would be too short -> Preemption forbidden
-        return false;
-    } else if (payloadBytesSent
-            >= kFramePreemptionMinNonFinalPayloadSize.get()) {
-        //Both the first part as well as the remaining part are large enough -> preemption possible at this time
-        return true;
-    }
-    //Too late to preempt or too early
-    return false;
+    //Both the first part as well as the remaining part are large enough
+    return simTime() >= preemptionWindowStart
+            && simTime() < preemptionWindowEnd;
 
 }
 
@@ -589,11 +766,54 @@ simtime_t EtherMACFullDuplexPreemptable::calculateTransmissionDuration(
 
 }
 
+simtime_t EtherMACFullDuplexPreemptable::interframeGapDuration() {
+    // same as in EtherMacFullDuplex::scheduleEndIFGPeriod()
+    return b(INTERFRAME_GAP_BITS).get() / curEtherDescr->txrate;
+}
+
+simtime_t EtherMACFullDuplexPreemptable::expressWaitTime() {
+    simtime_t endOfFragment = endTxMsg->isScheduled() ?
+            endTxMsg->getArrivalTime() : simTime();
+    simtime_t preemptionTime = isPreemptionNowPossible() ?
+            simTime() : isPreemptionLaterPossible();
+    if (preemptionTime.isZero()) {
+        // The non-preemptable tail of the frame has to be sent completely
+        numExpressWaitsForTail++;
+        return endOfFragment - simTime();
+    }
+    // Preempting ends the fragment after its mCRC, unless it ends earlier
+    // anyway
+    return std::min(endOfFragment,
+            preemptionTime + calculateTransmissionDuration(4)) - simTime();
+}
+
+void EtherMACFullDuplexPreemptable::updateHoldIdleState() {
+    bool idle = onHold && !transmittingExpressFrame
+            && !transmittingPreemptableFrame;
+    if (idle && !idleOnHold) {
+        holdIdleStart = simTime();
+    } else if (!idle && idleOnHold) {
+        // Only idle time that kept preemptable traffic off the link counts
+        simtime_t idleTime = simTime() - holdIdleStart;
+        if (idleTime > SIMTIME_ZERO
+                && (currentPreemptableFrame
+                        || transmissionSelectionModule->hasPreemptablePacketEnqueued())) {
+            holdIdleHistogram.collect(idleTime);
+            totalHoldIdleTime += idleTime;
+        }
+    }
+    idleOnHold = idle;
+}
+
 void EtherMACFullDuplexPreemptable::packetEnqueued(IPassiveQueue *queue) {
 
     Enter_Method("packetEnqueued()");
     if (transmittingPreemptableFrame && !transmittingExpressFrame && transmissionSelectionModule->hasExpressPacketEnqueued()) {
         emit(expressFrameEnqueuedWhileSendingPreemptableSignal, 0);
+        if (!expressWaitRecorded) {
+            expressWaitRecorded = true;
+            expressWaitHistogram.collect(expressWaitTime());
+        }
         std::string loggingPrefix = " Received express frame enqueued notification, ";
         if(isPreemptionNowPossible()) {
             //If direct sending is possible, request the frame
@@ -604,8 +824,7 @@ void EtherMACFullDuplexPreemptable::packetEnqueued(IPassiveQueue *queue) {
             if(!nextPreemptionPossible.isZero()) {
                 //If preemption is only possible later, schedule frame request to that time
                 EV_DETAIL << getFullPath() << " at t=" << simTime().inUnit(SIMTIME_NS) << "ns:" << loggingPrefix << "Preemption is possible later, scheduling express frame request for later." << endl;
-                cancelAndDelete(recheckForQueuedExpressFrameMsg);
-                recheckForQueuedExpressFrameMsg = new cMessage("recheckForQueuedExpressFrame");
+                cancelEvent(recheckForQueuedExpressFrameMsg);
                 scheduleAt(nextPreemptionPossible, recheckForQueuedExpressFrameMsg);
             } else {
                 EV_DETAIL << getFullPath() << " at t=" << simTime().inUnit(SIMTIME_NS) << "ns:" << loggingPrefix << "Preemption is not possible at all." << endl;
@@ -625,7 +844,12 @@ void EtherMACFullDuplexPreemptable::hold(simtime_t delay) {
         if(delay.isZero()) {
             //Execute hold request -> preempt current preemptable traffic, don't allow new one
             EV_INFO << getFullPath() << " at t=" << simTime().inUnit(SIMTIME_NS) << "ns:" << " Got hold request."<<endl;
+            if (!onHold) {
+                holdStart = simTime();
+            }
             onHold = true;
+            updateHoldIdleState();
+            transmissionSelectionModule->holdStateChanged(onHold);
             if (transmittingPreemptableFrame && isPreemptionNowPossible()) {
                 //Preempt now if possible
                 preemptCurrentFrame();
@@ -648,7 +872,14 @@ void EtherMACFullDuplexPreemptable::hold(simtime_t delay) {
         } else {
             //Schedule hold on specified time
             EV_INFO<<getFullPath() << " at t=" << simTime().inUnit(SIMTIME_NS) << "ns:" << " Scheduling hold in "<<delay.inUnit(SIMTIME_US)<<"us."<<endl;
-            scheduleAt(simTime() + delay, new cMessage("holdRequest", 1));
+            cMessage* holdRequestMsg;
+            if (holdRequestPool.empty()) {
+                holdRequestMsg = new cMessage("holdRequest", kHoldRequest);
+            } else {
+                holdRequestMsg = holdRequestPool.back();
+                holdRequestPool.pop_back();
+            }
+            scheduleAt(simTime() + delay, holdRequestMsg);
         }
     }
 
@@ -658,7 +889,12 @@ void EtherMACFullDuplexPreemptable::release() {
 
     Enter_Method("release()");
     if(par("enablePreemptingFrames")) {
+        if (onHold) {
+            holdDurationHistogram.collect(simTime() - holdStart);
+        }
         onHold = false;
+        updateHoldIdleState();
+        transmissionSelectionModule->holdStateChanged(onHold);
         EV_INFO<<getFullPath() << " at t=" << simTime().inUnit(SIMTIME_NS) << "ns:" << " Got release request. Requesting frame."<<endl;
         //Clear pending requests from this module, otherwise
         transmissionSelectionModule->removePendingRequests();
@@ -678,7 +914,7 @@ simtime_t EtherMACFullDuplexPreemptable::getHoldAdvance() {
 
     Enter_Method_Silent("release()");
     //Calculate the hold advance i.e. the maximum delay needed before express traffic can flow after a preemption/hold event
-    int bitsToWait = INTERFRAME_GAP_BITS.get() + kFramePreemptionMinNonFinalPayloadSize.get() + kFramePreemptionMinFinalPayloadSize.get() + 4;
+    int bitsToWait = INTERFRAME_GAP_BITS.get() + minNonFinalPayloadBytes + kFramePreemptionMinFinalPayloadSize.get() + 4;
     double transmitRate = getTxRate();
     ASSERT(transmitRate > 0);
     simtime_t timeForOneBit = SimTime(1, SIMTIME_S) / transmitRate;
@@ -16,6 +16,9 @@
 #ifndef __INET_ETHERMACFULLDUPLEXPREEMPTABLE_H
 #define __INET_ETHERMACFULLDUPLEXPREEMPTABLE_H
 
+#include <deque>
+#include <vector>
+
 #include "inet/common/INETDefs.h"
 #include "inet/common/queue/IPassiveQueue.h"
 #include "inet/linklayer/ethernet/EtherMacFullDuplex.h"
@@ -23,12 +26,14 @@
 #include "inet/linklayer/ethernet/EtherPhyFrame_m.h"
 #include "../../ieee8021q/queue/TransmissionSelection.h"
 #include "../../ieee8021q/Ieee8021q.h"
+#include "EncapsulatedFrame.h"
 
 using namespace inet;
 
 namespace nesting {
 
 class TransmissionSelection;
+class PreemptedFrame;
 /**
  * A simplified version of EtherMAC. Since modern Ethernets typically
  * operate over duplex links where's no contention, the original CSMA/CD
@@ -40,13 +45,23 @@ class EtherMACFullDuplexPreemptable: public EtherMacFullDuplex,
 private:
     TransmissionSelection* transmissionSelectionModule;
 
+    /**
+     * Kinds of the self-messages of this module in addition to the ones of
+     * EtherMacBase, used for dispatching in handleSelfMessage().
+     */
+    enum SelfMsgKind {
+        kRecheckForQueuedExpressFrame = 200, kPreemptCurrentFrame, kHoldRequest
+    };
+
     cMessage *recheckForQueuedExpressFrameMsg = nullptr;
     cMessage *preemptCurrentFrameMsg = nullptr;
 
-    //cMessage recheckForQueuedExpressFrameMsg = cMessage("RecheckForQueuedExpressFrame");
-    //cMessage preemptCurrentFrameMsg = cMessage("preemptCurrentFrame");
-//    cMessage *recheckForQueuedExpressFrameMsg = nullptr;
-//    cMessage *preemptCurrentFrameMsg = nullptr;
+    /**
+     * Hold-request messages that are currently not scheduled. Several delayed
+     * hold requests can be pending at the same time, so they are taken from
+     * and returned to this pool instead of being allocated per request.
+     */
+    std::vector<cMessage*> holdRequestPool;
 
     bool transmittingExpressFrame = false;
     Packet* currentExpressFrame = nullptr;
@@ -54,20 +69,163 @@ private:
     bool onHold = false;
     bool transmittingPreemptableFrame = false;
     Packet* currentPreemptableFrame = nullptr;
+
+    /**
+     * Image of currentPreemptableFrame as sent on the wire, shared by all of
+     * its fragments. Created when its first fragment is transmitted.
+     */
+    EncapsulatedFramePtr currentPreemptableImage;
+
+    /**
+     * True if curTxFrame stands for the remainder of currentPreemptableFrame
+     * instead of a frame from the queue.
+     */
+    bool continuingPreemptableFrame = false;
     simtime_t preemptableTransmissionStart;
 
     simtime_t pFrameArrivalTime;
     simtime_t eFrameArrivalTime;
 
-    unsigned int preemptedBytesReceived;
     unsigned int preemptedBytesSent;
-    EthernetSignal* receivedPreemptedFrame = nullptr;
+
+    /**
+     * True if the end of an express transmission and the following
+     * interframe gap are handled by a single endTxMsg event, in which the
+     * next frame is taken from the transmission selection.
+     */
+    bool singleEventTransmission = false;
+
+    /** Maximum number of frames requested at once, see maxBurstSize. */
+    int maxBurstSize = 1;
+
+    /** Frames of a burst that arrived while another frame was pending. */
+    std::deque<Packet*> burstFrames;
+
+    /** Minimum payload of a non-final fragment in bytes, from addFragSize. */
+    int minNonFinalPayloadBytes;
+
+    /**
+     * Time interval [preemptionWindowStart, preemptionWindowEnd) of the
+     * current preemptable transmission in which the transmission may be
+     * preempted, i.e. the fragment sent so far and the remainder of the frame
+     * are both large enough. Computed when the transmission starts.
+     */
+    simtime_t preemptionWindowStart;
+    simtime_t preemptionWindowEnd;
+
+    /**
+     * True if the current preemptable transmission can still be preempted
+     * when preemption is requested before the window starts.
+     */
+    bool preemptionLaterPossible = false;
+
+    /** Fragment count of the next fragment of currentPreemptableFrame. */
+    unsigned int fragmentCount = 0;
+
+    /** Receive state of the preempted frame currently reassembled. */
+    struct ReassemblyContext {
+        /** Frame being reassembled, null if no frame is in progress. */
+        EncapsulatedFramePtr frame;
+
+        /** Bytes of the frame received so far. */
+        unsigned int bytesReceived = 0;
+
+        /** Fragment count expected for the next fragment, modulo 4. */
+        unsigned int nextFragmentCount = 0;
+    } reassembly;
+
+    long numFramesReassembled = 0;
+
+    /** Number of frames discarded because of lost or reordered fragments. */
+    long numReassemblyErrors = 0;
+
+    /** Fragments of currentPreemptableFrame transmitted so far. */
+    unsigned int numFragmentsSent = 0;
+
+    /** Fragments per transmitted preemptable frame. */
+    cHistogram fragmentsPerFrameHistogram;
+
+    /**
+     * Preamble, SMD and mCRC bytes added by preemption, i.e. by all but the
+     * first fragment of the preemptable frames.
+     */
+    long numPreemptionOverheadBytes = 0;
+
+    /**
+     * Time from an express frame becoming ready during a preemptable
+     * transmission until the preemptable fragment is off the link.
+     */
+    cHistogram expressWaitHistogram;
+
+    /**
+     * True if the express wait of the current preemptable transmission has
+     * been recorded, only the first express frame is considered.
+     */
+    bool expressWaitRecorded = false;
+
+    /**
+     * Number of express frames that waited for the end of a preemptable
+     * frame because it could not be preempted any more.
+     */
+    long numExpressWaitsForTail = 0;
+
+    /** Durations from a hold request until the release. */
+    cHistogram holdDurationHistogram;
+    simtime_t holdStart;
+
+    /**
+     * Durations of link idle periods during holds that kept a preemptable
+     * frame waiting.
+     */
+    cHistogram holdIdleHistogram;
+    simtime_t totalHoldIdleTime;
+
+    /** True while on hold and the link is idle, since holdIdleStart. */
+    bool idleOnHold = false;
+    simtime_t holdIdleStart;
 
     virtual int calculatePreemptedPayloadBytesSent(simtime_t timeToCheck, bool sentCRC);
     virtual bool isPreemptionNowPossible();
     virtual simtime_t isPreemptionLaterPossible();
     virtual simtime_t calculateTransmissionDuration(int bytes);
+
+    /** Returns the duration of the interframe gap at the current rate. */
+    virtual simtime_t interframeGapDuration();
     virtual void preemptCurrentFrame();
+
+    /**
+     * Computes the preemption window of a preemptable transmission starting
+     * now.
+     */
+    virtual void computePreemptionWindow();
+
+    /**
+     * Returns a packet standing for currentPreemptableFrame while one of its
+     * fragments is transmitted. It shares the data of the frame.
+     */
+    virtual Packet* createPreemptableFramePlaceholder();
+
+    /** Creates the image of currentPreemptableFrame shared by its fragments. */
+    virtual EncapsulatedFramePtr createPreemptableImage();
+
+    /**
+     * Updates the transmit statistics for an express frame. Called right
+     * before the frame is handed over to the channel, because the frame is
+     * not kept until the end of its transmission.
+     */
+    virtual void recordExpressFrameSent(Packet* frame);
+
+    /**
+     * Returns how long an express frame that became ready now has to wait
+     * until the current preemptable fragment is off the link.
+     */
+    virtual simtime_t expressWaitTime();
+
+    /**
+     * Starts or ends an idle period of the link during a hold. Must be called
+     * whenever the hold or the transmission state changes.
+     */
+    virtual void updateHoldIdleState();
 protected:
     static simsignal_t preemptCurrentFrameSignal;
     static simsignal_t transmittedExpressFrameSignal;
@@ -84,6 +242,13 @@ protected:
 
     virtual void initialize(int stage) override;
     virtual void handleMessageWhenUp(cMessage *msg) override;
+    virtual void finish() override;
+
+    /**
+     * Adds a received fragment to the reassembly context and sends the
+     * frame up after its final fragment.
+     */
+    virtual void handlePreemptedFrame(PreemptedFrame* fragment);
     virtual void handleSelfMessage(cMessage *msg) override;
     virtual void handleEndTxPeriod() override;
     virtual void handleEndIFGPeriod() override;